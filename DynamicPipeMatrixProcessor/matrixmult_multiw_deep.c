@@ -2,94 +2,640 @@
 * Description: This module performs Compute Rsum in the parent by summing up results from children for
 * each line of W matrices. When the input of W matrices from stdin stops (Ctrl-D), print the final Rsum to stdout and exit,
 * ensuring to flush standard streams. Uses pipes to run the program with a file or standard input.
-* Last modified date: 10/25/2023
+* A set of persistent matrixmult_parallel workers is started once and takes the jobs of every line over a
+* control pipe; a worker is started again only if it dies. Workers print their results straight to stdout
+* and send each row back as a binary frame, which the parent adds into Rsum without parsing text.
+* With -i the running A stays in shared memory between rounds instead of being written to A_file and read
+* back every round; -c N also writes it to A_file every N rounds, and it is always written at exit.
+* With -s each round is computed as A*(W1 + ... + Wk) instead of A*W1 + ... + A*Wk: the W matrices are
+* summed with element-wise additions and A is multiplied once in the parent. The sum is kept between rounds
+* and only the W files that were added, removed or changed are added to it or subtracted from it.
+* Last modified date: 10/18/2026
 * Creation date: 10/20/2023
 **/
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <string.h>
+#include <sys/stat.h>
+
+#include "../Matrix_Common/matrix_fixed.h"
+#include "../Matrix_Common/result_frame.h"
+#include "../Matrix_Common/shared_matrix.h"
 
 #define MAX_ROWS 8
 #define MAX_COLS 8
 
+// How long the parent waits for a frame before checking that its workers are alive
+#define WORKER_POLL_MS 50
+
+// Times a job is handed out before the parent gives up on it
+#define JOB_ATTEMPT_LIMIT 3
+
+// One persistent worker
+typedef struct {
+    pid_t pid;   // 0 while the worker is not running
+    int control; // Write end of the worker's control pipe, which is its stdin
+} Worker;
+
+// The workers and the frame pipe they share
+typedef struct {
+    Worker *workers;
+    int count;
+    int results[2];        // Frame pipe; the parent keeps the write end to start new workers
+    uint32_t nextSequence; // Number of the next job handed out
+} WorkerSet;
+
+// One W file of the current line
+typedef struct {
+    uint32_t sequence; // Number of the latest hand-out; frames of earlier ones are stale
+    int worker;
+    int attempts;
+    int done;
+    int rows;                        // Row frames received for the latest hand-out
+    int partial[MAX_ROWS][MAX_COLS]; // Rows received so far, added into Rsum once the job ends
+} Job;
+
+// One W matrix in the running sum, as it was when it was added
+typedef struct {
+    char *path;
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+    int values[MAX_COLS][MAX_COLS];
+} WeightTerm;
+
+// Sum of the W matrices of the last round, with the terms it was built from
+typedef struct {
+    WeightTerm *terms;
+    int count;
+    int sum[MAX_COLS][MAX_COLS];
+} WeightSum;
+
+// How the running A is carried from one round to the next, and how a round is computed
+typedef struct {
+    const char *A_file;
+    SharedMatrix *shared; // Running A in shared memory, or NULL to rewrite A_file every round
+    WeightSum *weights;   // Running sum of the W matrices when rounds are computed as A*(sum of W), or NULL
+    int checkpointEvery;  // Rounds between writes of the shared A to A_file; 0 writes it only at exit
+    int round;            // Rounds completed
+    int unsaved;          // The shared A has changed since A_file was last written
+} Iteration;
+
 /**
- * This function updates a matrix based on the input string.
- * Input parameters: matrix, input.
+ * This function adds one result frame into the matrix. Frames outside the matrix are reported and skipped.
+ * Input parameters: matrix, header, values.
  **/
 
-void updateMatrix(int matrix[MAX_ROWS][MAX_COLS],  char* input) {
-    char *token = strtok(input, " ");
-    int col = 0;
-    while (token != NULL && col < MAX_COLS) {
-        matrix[0][col++] += atoi(token);
-        token = strtok(NULL, " ");
+void updateMatrix(int matrix[MAX_ROWS][MAX_COLS], const ResultFrameHeader *header, const int32_t *values) {
+    if (header->row >= MAX_ROWS || header->column > MAX_COLS || header->count > MAX_COLS - header->column) {
+        fprintf(stderr, "Ignoring result frame for row %u of job %u.\n", header->row, header->job);
+        return;
     }
+    int *row = matrix[header->row] + header->column;
+    addMatrices(row, values, row, header->count);
 }
 
 /**
- * This function executes matrix multiplication with multiple W files using child processes,
- * communicates with the child processes through pipes, and computes and stores the Rsum matrix.
- * Input parameters: A_file, W_files, numW - the number of W files, rsum - the Rsum matrix.
+ * This function starts worker index of the set: a matrixmult_parallel --worker whose stdin is a new
+ * control pipe and which sends its frames into the set's frame pipe.
+ * Input parameters: set, index. Returns 0, or -1 if it cannot be started.
  **/
-void executeMatrixMultMultiw(const char *A_file, char *W_files[], int numW, int (*rsum)[MAX_COLS]) {
-    int pipefd[2];
-    if (pipe(pipefd) == -1) {
-        perror("Pipe error"); // Create a pipe to communicate between parent and child processes
-        exit(1);
+
+int startWorker(WorkerSet *set, int index) {
+    Worker *worker = &set->workers[index];
+    int control[2];
+    if (pipe(control) == -1) {
+        perror("Pipe error");
+        return -1;
     }
 
-    for (int i = 0; i < numW; i++) {
-        pid_t child_pid = fork(); // Fork a child process
+    // fork copies the parent's unwritten output into the child, so write it out first
+    fflush(stdout);
+    pid_t child_pid = fork();
+    if (child_pid == -1) {
+        perror("Fork error");
+        close(control[0]);
+        close(control[1]);
+        return -1;
+    }
 
-        if (child_pid == -1) {
-            perror("Fork error"); // Check for fork failure
+    if (child_pid == 0) {
+        signal(SIGPIPE, SIG_DFL);
+        close(control[1]);
+        close(set->results[0]);
+        dup2(control[0], STDIN_FILENO); // The worker reads its jobs from stdin
+        close(control[0]);
+        if (shareResultChannel(set->results[1]) == -1) { // Tell the worker where to send its result frames
+            perror("setenv error");
             exit(1);
         }
+        execlp("./matrixmult_parallel", "./matrixmult_parallel", "--worker", NULL);
+        perror("exec error");
+        exit(1);
+    }
+
+    // Other workers must not hold this control pipe open, or the worker never sees it close
+    close(control[0]);
+    fcntl(control[1], F_SETFD, FD_CLOEXEC);
+    worker->pid = child_pid;
+    worker->control = control[1];
+    return 0;
+}
+
+/**
+ * This function starts count workers and the frame pipe they share, once for the whole run.
+ * Input parameters: set, count.
+ **/
+
+void startWorkers(WorkerSet *set, int count) {
+    // A worker that dies closes its control pipe; writing to it must fail, not kill the parent
+    signal(SIGPIPE, SIG_IGN);
 
-        if (child_pid == 0) {
-            close(pipefd[0]); // Close the read end of the pipe
-            dup2(pipefd[1], STDOUT_FILENO); // Redirect child process's standard output to the pipe
-            execlp("./matrixmult_parallel", "./matrixmult_parallel", A_file, W_files[i], NULL);
-            perror("exec error");
+    if (pipe(set->results) == -1) {
+        perror("Pipe error"); // Create a pipe to communicate between parent and child processes
+        exit(1);
+    }
+    fcntl(set->results[0], F_SETFD, FD_CLOEXEC);
+
+    set->workers = calloc(count, sizeof(Worker));
+    if (set->workers == NULL) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    set->count = count;
+    set->nextSequence = 0;
+    for (int i = 0; i < count; i++) {
+        set->workers[i].control = -1;
+        if (startWorker(set, i) == -1) {
             exit(1);
         }
     }
+}
 
-    close(pipefd[1]); // Close the write end of the pipe in the parent process
+/**
+ * This function reaps worker index after it died and closes its control pipe.
+ * Input parameters: set, index.
+ **/
 
-    char buffer[1024];
-    ssize_t bytesRead;
+void forgetWorker(WorkerSet *set, int index) {
+    Worker *worker = &set->workers[index];
+    if (worker->control != -1) {
+        close(worker->control);
+        worker->control = -1;
+    }
+    if (worker->pid != 0) {
+        waitpid(worker->pid, NULL, WNOHANG);
+        worker->pid = 0;
+    }
+}
 
-    printf("Children Resulting Matrices:\n");
+/**
+ * This function hands a job to its worker under a new sequence number, discarding the rows of any
+ * earlier hand-out. A worker that cannot take it is counted as dead and started again.
+ * Input parameters: set, job, A_file - NULL for the shared A, W_file.
+ * Returns 0, or -1 once the job has used up its attempts or its file names are too long to send.
+ **/
+
+int dispatchJob(WorkerSet *set, Job *job, const char *A_file, const char *W_file) {
+    while (job->attempts < JOB_ATTEMPT_LIMIT) {
+        job->attempts++;
+        job->sequence = set->nextSequence++;
+        job->rows = 0;
+        memset(job->partial, 0, sizeof(job->partial));
 
-    // Read the results from the children processes through the pipe
-    while ((bytesRead = read(pipefd[0], buffer, sizeof(buffer))) > 0) {
-        int result;
-        buffer[bytesRead] = '\0';
-        printf("%s", buffer);
+        Worker *worker = &set->workers[job->worker];
+        if (worker->pid == 0 && startWorker(set, job->worker) == -1) {
+            continue;
+        }
 
-        updateMatrix(rsum,buffer); // Update the Rsum matrix with the received data
+        if (sendJobRecord(worker->control, job->sequence, A_file, W_file) == 0) {
+            return 0;
+        }
+        if (errno == ENAMETOOLONG) {
+            fprintf(stderr, "Giving up on %s: file name too long.\n", W_file);
+            job->done = 1;
+            return -1;
+        }
+        forgetWorker(set, job->worker);
     }
+    fprintf(stderr, "Giving up on %s after %d attempts.\n", W_file, JOB_ATTEMPT_LIMIT);
+    job->done = 1;
+    return -1;
+}
 
-    printf("\n");
-    close(pipefd[0]); // Close the read end of the pipe in the parent process
+/**
+ * This function finds workers that died, starts them again and hands their unfinished jobs out again.
+ * Input parameters: set, jobs, numW, A_file - NULL for the shared A, W_files.
+ * Returns the number of jobs given up on.
+ **/
+
+int restartDeadWorkers(WorkerSet *set, Job *jobs, int numW, const char *A_file, char *W_files[]) {
+    int givenUp = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        for (int i = 0; i < set->count; i++) {
+            if (set->workers[i].pid != pid) {
+                continue;
+            }
+            fprintf(stderr, "Worker %d died, starting it again.\n", pid);
+            set->workers[i].pid = 0;
+            forgetWorker(set, i);
+            for (int j = 0; j < numW; j++) {
+                if (!jobs[j].done && jobs[j].worker == i && dispatchJob(set, &jobs[j], A_file, W_files[j]) == -1) {
+                    givenUp++;
+                }
+            }
+        }
+    }
+    return givenUp;
+}
+
+/**
+ * This function closes every control pipe, which ends the workers, and waits for them.
+ * Input parameters: set.
+ **/
+
+void stopWorkers(WorkerSet *set) {
+    for (int i = 0; i < set->count; i++) {
+        if (set->workers[i].control != -1) {
+            close(set->workers[i].control);
+        }
+    }
+    for (int i = 0; i < set->count; i++) {
+        if (set->workers[i].pid != 0) {
+            waitpid(set->workers[i].pid, NULL, 0);
+        }
+    }
+    close(set->results[0]);
+    close(set->results[1]);
+    free(set->workers);
+}
 
-    FILE *outfile = fopen(A_file, "w"); // Open A_file in write mode
+/**
+ * This function writes the running A, the first row of Rsum, to A_file. It is written under a
+ * temporary name and renamed, so a checkpoint interrupted halfway leaves the previous one intact.
+ * Input parameters: A_file, row.
+ **/
+
+void writeRunningA(const char *A_file, const int *row) {
+    char temporary[PATH_MAX];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", A_file);
+
+    FILE *outfile = fopen(temporary, "w"); // Open the temporary file in write mode
     if (outfile == NULL) {
         perror("Error opening file for writing");
         exit(1);
     }
 
     // Write the resulting rsum array to the file
-    for (int i = 0; i < 8; i++) {
-        fprintf(outfile, "%d ", rsum[0][i]);
+    for (int i = 0; i < MAX_COLS; i++) {
+        fprintf(outfile, "%d ", row[i]);
     }
     fprintf(outfile, "\n");
-    fclose(outfile); // Close the file
+    if (fclose(outfile) != 0 || rename(temporary, A_file) == -1) { // Close the file and put it in place
+        perror("Error writing file");
+        unlink(temporary);
+        exit(1);
+    }
+}
+
+/**
+ * This function makes the first row of Rsum the A of the next round: in shared memory, written to
+ * A_file every checkpoint interval, or written to A_file every round when there is no shared A.
+ * Input parameters: iteration, row.
+ **/
+
+void storeRound(Iteration *iteration, const int *row) {
+    iteration->round++;
+    if (iteration->shared == NULL) {
+        writeRunningA(iteration->A_file, row);
+        return;
+    }
+
+    // The same matrix the workers would read back from A_file
+    memset(iteration->shared->data, 0, MAX_ROWS * MAX_COLS * sizeof(int));
+    memcpy(iteration->shared->data, row, MAX_COLS * sizeof(int));
+    iteration->unsaved = 1;
+    if (iteration->checkpointEvery > 0 && iteration->round % iteration->checkpointEvery == 0) {
+        writeRunningA(iteration->A_file, row);
+        iteration->unsaved = 0;
+    }
+}
+
+/**
+ * This function loads A_file into shared memory for an in-memory iteration. It is called before the
+ * workers start, so they inherit the matrix. Exits if A_file cannot be read.
+ * Input parameters: iteration.
+ **/
+
+void startIteration(Iteration *iteration) {
+    iteration->shared = createSharedMatrix(MAX_ROWS, MAX_COLS);
+    if (iteration->shared == NULL) {
+        perror("Shared memory error");
+        exit(1);
+    }
+
+    FILE *fileA = fopen(iteration->A_file, "r");
+    if (fileA == NULL) {
+        fprintf(stderr, "Error opening input file(s).\n");
+        exit(1);
+    }
+    int status = readMatrixFromFile(fileA, iteration->shared->data, MAX_ROWS, MAX_COLS);
+    fclose(fileA);
+    if (status == -1) {
+        // A partly read A must not be multiplied, let alone written back over the user's file
+        fprintf(stderr, "Error reading input file %s.\n", iteration->A_file);
+        exit(1);
+    }
+}
+
+/**
+ * This function writes the shared A to A_file if it changed since the last checkpoint.
+ * Input parameters: iteration.
+ **/
+
+void finishIteration(Iteration *iteration) {
+    if (iteration->shared != NULL && iteration->unsaved) {
+        writeRunningA(iteration->A_file, iteration->shared->data);
+        iteration->unsaved = 0;
+    }
+}
+
+/**
+ * This function reads a W file into a term of the sum, recording which version of the file it holds.
+ * Input parameters: term, path, info - the file's status. Returns 0, or -1 if the file cannot be read.
+ **/
+
+int loadWeightTerm(WeightTerm *term, const char *path, const struct stat *info) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    int status = readMatrixFromFile(file, &term->values[0][0], MAX_COLS, MAX_COLS);
+    fclose(file);
+    term->path = strdup(path);
+    if (status == -1 || term->path == NULL) {
+        free(term->path);
+        return -1;
+    }
+    term->device = info->st_dev;
+    term->inode = info->st_ino;
+    term->size = info->st_size;
+    term->modified = info->st_mtim;
+    return 0;
+}
+
+/**
+ * This function subtracts a term from the sum. Like the additions, it wraps around on overflow, so
+ * adding a term and subtracting it again always restores the sum exactly.
+ * Input parameters: sum, term.
+ **/
+
+void subtractWeightTerm(int sum[MAX_COLS][MAX_COLS], const WeightTerm *term) {
+    unsigned *total = (unsigned *)&sum[0][0];
+    const unsigned *values = (const unsigned *)&term->values[0][0];
+    for (int i = 0; i < MAX_COLS * MAX_COLS; i++) {
+        total[i] -= values[i];
+    }
+}
+
+/**
+ * This function brings the sum of W matrices up to date with this round's W files. A W file that was
+ * in the last round and has not changed keeps its term without being read again; the others are read
+ * and added, and the terms of W files that left or changed are subtracted. When most terms changed,
+ * the sum is rebuilt instead. A W file that cannot be read is reported and left out, as a child
+ * that cannot open it contributes nothing.
+ * Input parameters: weights, W_files, numW - the number of W files.
+ **/
+
+void updateWeightSum(WeightSum *weights, char *W_files[], int numW) {
+    WeightTerm *terms = calloc(numW > 0 ? numW : 1, sizeof(WeightTerm));
+    char *fresh = calloc(numW > 0 ? numW : 1, 1);
+    char *kept = calloc(weights->count > 0 ? weights->count : 1, 1);
+    if (terms == NULL || fresh == NULL || kept == NULL) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+
+    int count = 0;
+    int changes = 0;
+    for (int i = 0; i < numW; i++) {
+        struct stat info;
+        if (stat(W_files[i], &info) == -1) {
+            fprintf(stderr, "Error opening input file %s.\n", W_files[i]);
+            continue;
+        }
+
+        // Take over an unchanged term of the last round
+        int reused = 0;
+        for (int j = 0; j < weights->count && !reused; j++) {
+            WeightTerm *old = &weights->terms[j];
+            if (!kept[j] && strcmp(old->path, W_files[i]) == 0 && old->device == info.st_dev &&
+                old->inode == info.st_ino && old->size == info.st_size &&
+                old->modified.tv_sec == info.st_mtim.tv_sec && old->modified.tv_nsec == info.st_mtim.tv_nsec) {
+                terms[count++] = *old;
+                old->path = NULL;
+                kept[j] = 1;
+                reused = 1;
+            }
+        }
+        if (reused) {
+            continue;
+        }
+
+        if (loadWeightTerm(&terms[count], W_files[i], &info) == -1) {
+            fprintf(stderr, "Error opening input file %s.\n", W_files[i]);
+            continue;
+        }
+        fresh[count++] = 1;
+        changes++;
+    }
+    for (int j = 0; j < weights->count; j++) {
+        changes += !kept[j];
+    }
+
+    if (changes > count) {
+        // Rebuilding takes fewer additions than patching
+        memset(weights->sum, 0, sizeof(weights->sum));
+        for (int i = 0; i < count; i++) {
+            addMatrices(&weights->sum[0][0], &terms[i].values[0][0], &weights->sum[0][0], MAX_COLS * MAX_COLS);
+        }
+    } else {
+        for (int j = 0; j < weights->count; j++) {
+            if (!kept[j]) {
+                subtractWeightTerm(weights->sum, &weights->terms[j]);
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            if (fresh[i]) {
+                addMatrices(&weights->sum[0][0], &terms[i].values[0][0], &weights->sum[0][0], MAX_COLS * MAX_COLS);
+            }
+        }
+    }
+
+    for (int j = 0; j < weights->count; j++) {
+        free(weights->terms[j].path);
+    }
+    free(weights->terms);
+    free(fresh);
+    free(kept);
+    weights->terms = terms;
+    weights->count = count;
+}
+
+/**
+ * This function frees the terms of a sum of W matrices.
+ * Input parameters: weights.
+ **/
+
+void freeWeightSum(WeightSum *weights) {
+    for (int i = 0; i < weights->count; i++) {
+        free(weights->terms[i].path);
+    }
+    free(weights->terms);
+    weights->terms = NULL;
+    weights->count = 0;
+}
+
+/**
+ * This function computes Rsum for a round as A*(W1 + ... + Wk): it updates the sum of the W matrices
+ * and multiplies the running A by it once, in the parent.
+ * Input parameters: iteration, W_files, numW - the number of W files, rsum - the Rsum matrix.
+ * Returns the number of W matrices in the sum, or 0 if A could not be read.
+ **/
+
+int multiplyWeightSum(Iteration *iteration, char *W_files[], int numW, int (*rsum)[MAX_COLS]) {
+    updateWeightSum(iteration->weights, W_files, numW);
+
+    int A[MAX_ROWS][MAX_COLS] = {{0}};
+    if (iteration->shared != NULL) {
+        memcpy(A, iteration->shared->data, sizeof(A));
+    } else {
+        FILE *fileA = fopen(iteration->A_file, "r");
+        if (fileA == NULL) {
+            fprintf(stderr, "Error opening input file(s).\n");
+            return 0;
+        }
+        int status = readMatrixFromFile(fileA, &A[0][0], MAX_ROWS, MAX_COLS);
+        fclose(fileA);
+        if (status == -1) {
+            fprintf(stderr, "Error reading input file %s.\n", iteration->A_file);
+            return 0;
+        }
+    }
+
+    if (gemmShape(&A[0][0], &iteration->weights->sum[0][0], &rsum[0][0], MAX_ROWS, MAX_COLS, MAX_COLS) == -1) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 0;
+    }
+    return iteration->weights->count;
+}
+
+/**
+ * This function runs one job per W file on the persistent workers, collects their result frames
+ * through the shared pipe and adds each finished job into Rsum.
+ * Input parameters: A_file - NULL for the shared A, W_files, numW - the number of W files,
+ * rsum - the Rsum matrix, set - the workers.
+ * Returns the number of jobs that sent a result; a job whose files could not be read ends without one.
+ **/
+
+int collectProducts(const char *A_file, char *W_files[], int numW, int (*rsum)[MAX_COLS], WorkerSet *set) {
+    Job *jobs = calloc(numW > 0 ? numW : 1, sizeof(Job));
+    if (jobs == NULL) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+
+    // Workers print their results themselves, after this header
+    printf("Children Resulting Matrices:\n");
+    fflush(stdout);
+
+    // Spread the W files over the workers
+    int remaining = numW;
+    for (int i = 0; i < numW; i++) {
+        jobs[i].worker = i % set->count;
+        if (dispatchJob(set, &jobs[i], A_file, W_files[i]) == -1) {
+            remaining--;
+        }
+    }
+
+    ResultFrameHeader header;
+    int32_t values[RESULT_FRAME_VALUES];
+    struct pollfd results = {set->results[0], POLLIN, 0};
+
+    // Collect each job's rows, and add them into Rsum once the job has ended
+    int succeeded = 0;
+    while (remaining > 0) {
+        int ready = poll(&results, 1, WORKER_POLL_MS);
+        if (ready == -1 && errno != EINTR) {
+            perror("Poll error");
+            break;
+        }
+        if (ready <= 0) {
+            remaining -= restartDeadWorkers(set, jobs, numW, A_file, W_files);
+            continue;
+        }
+        if (receiveResultFrame(set->results[0], &header, values) != 1) {
+            fprintf(stderr, "Error reading result frames.\n");
+            break;
+        }
+
+        Job *job = NULL;
+        for (int i = 0; i < numW && job == NULL; i++) {
+            if (!jobs[i].done && jobs[i].sequence == header.job) {
+                job = &jobs[i];
+            }
+        }
+        if (job == NULL) {
+            continue; // Left over from a worker that died
+        }
+        if (header.row == RESULT_ROW_DONE) {
+            addMatrices(&rsum[0][0], &job->partial[0][0], &rsum[0][0], MAX_ROWS * MAX_COLS);
+            job->done = 1;
+            succeeded += job->rows > 0;
+            remaining--;
+        } else {
+            updateMatrix(job->partial, &header, values); // Update the job's rows with the received row
+            job->rows++;
+        }
+    }
+    free(jobs);
+    return succeeded;
+}
+
+/**
+ * This function computes the Rsum matrix of one round, on the persistent workers or, with a sum of
+ * W matrices, as one multiplication in the parent, and stores and prints it.
+ * Input parameters: iteration - where the running A is kept, W_files, numW - the number of W files,
+ * rsum - the Rsum matrix, set - the workers.
+ **/
+void executeMatrixMultMultiw(Iteration *iteration, char *W_files[], int numW, int (*rsum)[MAX_COLS], WorkerSet *set) {
+    int products;
+    if (iteration->weights != NULL) {
+        // Every product shares A, so the sum of products is A times the sum of the W matrices
+        products = multiplyWeightSum(iteration, W_files, numW, rsum);
+    } else {
+        // Workers read the shared A when there is one
+        products = collectProducts(iteration->shared != NULL ? NULL : iteration->A_file, W_files, numW, rsum, set);
+    }
+
+    printf("\n");
+
+    // A round without a single product says nothing about A, so A is not replaced by zeros
+    if (products > 0) {
+        storeRound(iteration, rsum[0]);
+    } else {
+        fprintf(stderr, "No W matrix could be multiplied, keeping A1 unchanged.\n");
+    }
 
     printf("Resulting Matrix Rsum in A1:\n");
 
@@ -111,21 +657,55 @@ void executeMatrixMultMultiw(const char *A_file, char *W_files[], int numW, int
  **/
 
 int main(int argc, char *argv[]) {
+    const char *program = argv[0];
+    Iteration iteration = {0};
+    int inMemory = 0;
+    int option;
+
+    // -i keeps the running A in shared memory; -c N also writes it to A_file every N rounds;
+    // -s multiplies A once by the sum of the W matrices
+    while ((option = getopt(argc, argv, "+ic:s")) != -1) {
+        if (option == 'i') {
+            inMemory = 1;
+        } else if (option == 's') {
+            iteration.weights = calloc(1, sizeof(WeightSum));
+            if (iteration.weights == NULL) {
+                perror("Memory allocation failed");
+                exit(1);
+            }
+        } else if (option == 'c' && atoi(optarg) >= 0) {
+            inMemory = 1;
+            iteration.checkpointEvery = atoi(optarg);
+        } else {
+            argc = 0; // Print the usage below
+        }
+    }
+    argv += optind - 1;
+    argc -= optind - 1;
+
     // Check if the correct number of command-line arguments is provided
     if (argc < 3) {
-        fprintf(stderr, "Usage: %s <A_matrix_file> <W1_matrix_file> [W2_matrix_file] [W3_matrix_file] ...\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-i] [-c rounds] [-s] <A_matrix_file> <W1_matrix_file> [W2_matrix_file] [W3_matrix_file] ...\n", program);
         exit(1);
     }
 
-    const char *A_file = argv[1]; // Set A_file to the first command-line argument
+    iteration.A_file = argv[1]; // Set A_file to the first command-line argument
     char *W_files[argc - 2]; // Create an array to store W filenames
 
     for (int i = 2; i < argc; i++) {
         W_files[i - 2] = argv[i]; // Populate the W_files array with command-line arguments
     }
 
+    if (inMemory) {
+        startIteration(&iteration); // Before the workers start, so they inherit the shared A
+    }
+
     int rsum[MAX_ROWS][MAX_COLS] = {{0}}; // Initialize the Rsum matrix with zeros
-    executeMatrixMultMultiw(A_file, W_files, argc - 2, rsum); // Perform matrix multiplication with A and W files
+    WorkerSet workers = {0};
+    if (iteration.weights == NULL) {
+        startWorkers(&workers, argc - 2); // One persistent worker per W file on the command line
+    }
+    executeMatrixMultMultiw(&iteration, W_files, argc - 2, rsum, &workers); // Perform matrix multiplication with A and W files
 
     char** FILES = NULL; // Initialize to NULL initially
     char line[100];
@@ -145,7 +725,7 @@ int main(int argc, char *argv[]) {
         if (feof(stdin)) {
             break; // Reached end of input (Ctrl+D)
         }
-        executeMatrixMultMultiw(A_file, FILES, numFILES, rsum);
+        executeMatrixMultMultiw(&iteration, FILES, numFILES, rsum, &workers);
 
         // Free allocated memory for the next line
         for (int i = 0; i < numFILES; i++) {
@@ -156,5 +736,13 @@ int main(int argc, char *argv[]) {
         numFILES = 0;
     }
 
+    if (workers.count > 0) {
+        stopWorkers(&workers);
+    }
+    finishIteration(&iteration);
+    if (iteration.weights != NULL) {
+        freeWeightSum(iteration.weights);
+        free(iteration.weights);
+    }
     return 0;
 }
@@ -1,7 +1,10 @@
 /**
 * Description: This module performs performs parallel matrix multiplication by forking child processes.
 * Redirects its standard output to a pipe, the child writes data to the pipe for the parent to process
-* Last modified date: 10/25/2023
+* With --worker it runs as a persistent worker of matrixmult_multiw_deep: it reads binary job records
+* from stdin, keeps the W matrices it has parsed resident, multiplies in-process and sends each
+* result row back as a binary frame. A job without an A file takes the running A its parent keeps in shared memory.
+* Last modified date: 10/18/2026
 * Creation date: 10/20/2023
 **/
 
@@ -10,6 +13,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -18,51 +22,188 @@
 #define MAX_ROWS 8
 #define MAX_COLS 8
 
-/** This function reads a matrix, fills in the values from the file.
- * Input parameters: file - input, matrix, rows - the number of rows in the matrix,
- * cols - the number of columns in the matrix.
+#include "../Matrix_Common/matrix_fixed.h"
+#include "../Matrix_Common/result_frame.h"
+#include "../Matrix_Common/shared_matrix.h"
+
+// W matrices a worker keeps parsed
+#define RESIDENT_SLOTS 32
+
+// One parsed W matrix, valid while its file keeps the same identity, size and modification time
+typedef struct {
+    char path[PATH_MAX];
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+    unsigned long lastUse; // 0 while the slot is empty
+    int values[MAX_COLS * MAX_COLS];
+} ResidentMatrix;
+
+static ResidentMatrix resident[RESIDENT_SLOTS];
+static unsigned long residentClock;
+
+// Running A of an in-memory iteration, or NULL when the parent keeps A in its file
+static const SharedMatrix *sharedA;
+
+/**
+ * This function prints the nonzero rows of the result on one line, followed by the runtime.
+ * Input parameters: R, execution_time.
  **/
-void readMatrixFromFile(FILE *file, int *matrix, int rows, int cols) {
-    // Initialize the matrix with zeros
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            matrix[i * cols + j] = 0;
+
+void printResult(const int *R, double execution_time) {
+    for (int i = 0; i < MAX_ROWS; i++) {
+        if (R[i * MAX_COLS] != 0)
+        {
+            for (int j = 0; j < MAX_COLS; j++) {
+                printf("%d ", R[i * MAX_COLS + j]);
+            }
         }
     }
+    printf ("\n");
+
+    fflush(stdout);
+
+    // Print runtime in seconds
+    printf("Runtime %.4f seconds\n", execution_time);
+}
 
-    // Read the values from the file and fill in the matrix
-    char buffer[1024];
+/**
+ * This function returns the parsed W matrix of a file, parsing it only when the file is new or has
+ * changed since it was last parsed. The least recently used matrix makes room for a new one.
+ * Input parameters: path. Returns NULL if the file cannot be read.
+ **/
 
-    for (int i = 0; i < rows; i++) {
-        if (fgets(buffer, sizeof(buffer), file) != NULL) {
-            char *token = strtok(buffer, " ");
-            for (int j = 0; j < cols; j++) {
-                if (token != NULL) {
+const int *loadResidentMatrix(const char *path) {
+    struct stat info;
+    if (stat(path, &info) == -1) {
+        return NULL;
+    }
 
-                    // Convert token to integer and store in matrix
-                    matrix[i * cols + j] = atoi(token);
-                    token = strtok(NULL, " ");
-                } else {
-                    break;
-                }
+    ResidentMatrix *slot = &resident[0];
+    for (int i = 0; i < RESIDENT_SLOTS; i++) {
+        ResidentMatrix *entry = &resident[i];
+        if (entry->lastUse != 0 && strcmp(entry->path, path) == 0) {
+            if (entry->device == info.st_dev && entry->inode == info.st_ino && entry->size == info.st_size &&
+                entry->modified.tv_sec == info.st_mtim.tv_sec && entry->modified.tv_nsec == info.st_mtim.tv_nsec) {
+                entry->lastUse = ++residentClock;
+                return entry->values;
             }
+            slot = entry;
+            break;
         }
+        if (entry->lastUse < slot->lastUse) {
+            slot = entry;
+        }
+    }
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+    int status = readMatrixFromFile(file, slot->values, MAX_COLS, MAX_COLS);
+    fclose(file);
+    if (status == -1 || strlen(path) >= sizeof(slot->path)) {
+        slot->lastUse = 0;
+        return NULL;
     }
+
+    strcpy(slot->path, path);
+    slot->device = info.st_dev;
+    slot->inode = info.st_ino;
+    slot->size = info.st_size;
+    slot->modified = info.st_mtim;
+    slot->lastUse = ++residentClock;
+    return slot->values;
 }
 
 /**
- * This function performs the multiplication of a row of matrix A with matrix W
- * and stores the result in matrix R.
- * Input parameters: A, W, R, rowA, colsA, colsW.
+ * This function loads the A of a job: the shared running A for NULL, the file otherwise.
+ * A changes between rounds, so it is loaded for every job.
+ * Input parameters: A_file, A. Returns 0, or -1 if A cannot be opened or does not parse.
  **/
 
-void multiplyRow(int *A, int *W, int *R, int rowA, int colsA, int colsW) {
-    for (int j = 0; j < colsW; j++) {
-        R[rowA * colsW + j] = 0;
-        for (int k = 0; k < colsA; k++) {
-            R[rowA * colsW + j] += A[rowA * colsA + k] * W[k * colsW + j];
+int loadJobMatrix(const char *A_file, int *A) {
+    if (A_file == NULL) {
+        if (sharedA == NULL) {
+            return -1;
         }
+        copyMatrixPadded(sharedA->data, sharedA->rows, sharedA->cols, A, MAX_ROWS, MAX_COLS);
+        return 0;
+    }
+
+    FILE *fileA = fopen(A_file, "r");
+    if (fileA == NULL) {
+        return -1;
     }
+    int status = readMatrixFromFile(fileA, A, MAX_ROWS, MAX_COLS);
+    fclose(fileA);
+    return status;
+}
+
+/**
+ * This function runs one job of a worker: multiplies A by W in-process, prints the result like a
+ * single run and sends its rows followed by the end-of-job frame. A job whose files cannot be read
+ * is reported and ends with no rows, so the parent never waits for it.
+ * Input parameters: resultFd, job, A_file - NULL for the shared A, W_file. Returns -1 if the parent can no longer be reached.
+ **/
+
+int runWorkerJob(int resultFd, uint32_t job, const char *A_file, const char *W_file) {
+    clock_t start_time = clock();
+
+    int A[MAX_ROWS * MAX_COLS];
+    int R[MAX_ROWS * MAX_COLS];
+    const int *W = loadResidentMatrix(W_file);
+    if (W == NULL || loadJobMatrix(A_file, A) == -1) {
+        fprintf(stderr, "Error opening input file(s).\n");
+        return sendResultDone(resultFd, job);
+    }
+
+    if (gemmShape(A, W, R, MAX_ROWS, MAX_COLS, MAX_COLS) == -1) {
+        fprintf(stderr, "Memory allocation failed in worker %d.\n", getpid());
+        return sendResultDone(resultFd, job);
+    }
+
+    printResult(R, ((double)(clock() - start_time)) / CLOCKS_PER_SEC);
+    fflush(stdout);
+
+    for (int i = 0; i < MAX_ROWS; i++) {
+        if (sendResultRow(resultFd, job, i, R + i * MAX_COLS, MAX_COLS) == -1) {
+            return -1;
+        }
+    }
+    return sendResultDone(resultFd, job);
+}
+
+/**
+ * This function runs a persistent worker: it takes job records from stdin until the parent closes it.
+ * Returns the exit code.
+ **/
+
+int runWorker(void) {
+    int resultFd = attachResultChannel();
+    if (resultFd == -1) {
+        fprintf(stderr, "Worker started without %s.\n", RESULT_FD_ENV);
+        return 1;
+    }
+    sharedA = attachSharedMatrix();
+
+    JobRecord record;
+    char A_file[PATH_MAX];
+    char W_file[PATH_MAX];
+    int status;
+    while ((status = receiveJobRecord(STDIN_FILENO, &record, A_file, W_file)) == 1) {
+        // Every job ends with a done frame, even one whose names were too long to read
+        if (runWorkerJob(resultFd, record.job, record.aLength == 0 ? NULL : A_file, W_file) == -1) {
+            perror("Result write error");
+            return 1;
+        }
+    }
+    if (status == -1) {
+        fprintf(stderr, "Error reading job records.\n");
+        return 1;
+    }
+    return 0;
 }
 
 /**
@@ -75,9 +216,13 @@ int main(int argc, char *argv[]) {
     clock_t start_time, end_time;
     double execution_time;
 
+    if (argc == 2 && strcmp(argv[1], "--worker") == 0) {
+        return runWorker();
+    }
+
     // Check if the correct number of command-line arguments is provided
     if (argc != 3) {
-        fprintf(stderr, "Usage: %s <A_matrix_file> <W_matrix_file>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <A_matrix_file> <W_matrix_file>\n       %s --worker\n", argv[0], argv[0]);
         exit(1);
     }
 
@@ -98,12 +243,17 @@ int main(int argc, char *argv[]) {
     }
 
     // Read matrices from files
-    readMatrixFromFile(fileA, A, MAX_ROWS, MAX_COLS);
-    readMatrixFromFile(fileW, W, MAX_COLS, MAX_COLS);
+    int statusA = readMatrixFromFile(fileA, A, MAX_ROWS, MAX_COLS);
+    int statusW = readMatrixFromFile(fileW, W, MAX_COLS, MAX_COLS);
 
     fclose(fileA);
     fclose(fileW);
 
+    if (statusA == -1 || statusW == -1) {
+        fprintf(stderr, "Error reading input file(s).\n");
+        exit(1);
+    }
+
     // Create processes (one for each row of A)
     for (int i = 0; i < MAX_ROWS; i++) {
         pid_t pid;
@@ -119,7 +269,11 @@ int main(int argc, char *argv[]) {
         if (pid == 0) {
             close(pipefd[0]);
 
-            multiplyRow(A, W, R, i, MAX_COLS, MAX_COLS);
+            // Each row is a 1 x MAX_COLS by MAX_COLS x MAX_COLS product with its own specialized kernel
+            if (gemmShape(A + i * MAX_COLS, W, R + i * MAX_COLS, 1, MAX_COLS, MAX_COLS) == -1) {
+                fprintf(stderr, "Memory allocation failed in child %d.\n", getpid());
+                exit(1);
+            }
 
             // Send the result row through the pipe to the parent
             write(pipefd[1], R + i * MAX_COLS, MAX_COLS * sizeof(int));
@@ -147,21 +301,9 @@ int main(int argc, char *argv[]) {
     end_time = clock();
     execution_time = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
 
-    // Print out the matrix
-    for (int i = 0; i < MAX_ROWS; i++) {
-        if (R[i * MAX_COLS] != 0)
-        {
-            for (int j = 0; j < MAX_COLS; j++) {
-                printf("%d ", R[i * MAX_COLS + j]);
-            }
-        }
-    }
-    printf ("\n");
+    // Print out the matrix and the runtime
+    printResult(R, execution_time);
 
-    fflush(stdout);
-
-    // Print runtime in seconds
-    printf("Runtime %.4f seconds\n", execution_time);
     return 0;
 }
 
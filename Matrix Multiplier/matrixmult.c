@@ -2,7 +2,7 @@
 * Description: This module reads three matrices from input files, performs  matrix
 * multiplication and addition and prints the resulting matrix. Also handles file input errors.
 * Author names: Shivansh Chhabra, Kean lee
-* Last modified date: 09/11/2023
+* Last modified date: 10/18/2026
 * Creation date: 09/09/ 2023
 **/
 
@@ -11,25 +11,7 @@
 #include <stdbool.h>
 #include <string.h>
 
-// Function to read a matrix from a file into D array
-void readMatrixFromFile(FILE *file, int *matrix, int rows, int cols) {
-
-    char buffer[1024]; // Assuming a line will have less than 1024 characters
-
-    for(int i = 0; i < rows; i++) {
-        if(fgets(buffer, sizeof(buffer), file) != NULL) {
-            char *token = strtok(buffer, " ");
-            for(int j = 0; j < cols; j++) {
-                if(token != NULL) {
-                    matrix[i * cols + j] = atoi(token); // Convert token to integer and store in matrix
-                    token = strtok(NULL, " ");
-                } else {
-                    matrix[i * cols + j] = 0; // If no more tokens, set matrix element to 0
-                }
-            }
-        }
-    }
-}
+#include "../Matrix_Common/matrix_fixed.h"
 
 // Function to print a matrix
 void printMatrix(int *matrix, int rows, int cols) {
@@ -41,16 +23,11 @@ void printMatrix(int *matrix, int rows, int cols) {
     }
 }
 
-// Function to perform matrix multiplication and addition
-void multiplyAndAddMatrices(int *A, int *W, int *B, int *R) {
-    // Perform matrix multiplication: R = A * W
-    for (int i = 0; i < 1; i++) {
-        for (int j = 0; j < 5; j++) {
-            R[i * 5 + j] = 0;
-            for (int k = 0; k < 3; k++) {
-                R[i * 5 + j] += A[i * 3 + k] * W[k * 5 + j];
-            }
-        }
+// Function to perform matrix multiplication and addition, returns -1 if the multiplication fails
+int multiplyAndAddMatrices(int *A, int *W, int *B, int *R) {
+    // Perform matrix multiplication: R = A * W, using the kernel specialized for 1x3 * 3x5
+    if (gemmShape(A, W, R, 1, 3, 5) == -1) {
+        return -1;
     }
 
     // Perform matrix addition: R = R + B
@@ -59,6 +36,7 @@ void multiplyAndAddMatrices(int *A, int *W, int *B, int *R) {
             R[i * 5 + j] += B[i * 5 + j];
         }
     }
+    return 0;
 }
 
 
@@ -103,14 +81,20 @@ int main(int argc, char *argv[]) {
     int R[5] = {0}; // Result matrix
 
     // Read matrices from files using readMatrixFromFile
-    readMatrixFromFile(fileA, A, 1, 3);
-    readMatrixFromFile(fileW, W, 3, 5);
-    readMatrixFromFile(fileB, B, 1, 5);
+    int statusA = readMatrixFromFile(fileA, A, 1, 3);
+    int statusW = readMatrixFromFile(fileW, W, 3, 5);
+    int statusB = readMatrixFromFile(fileB, B, 1, 5);
 
     fclose(fileA);
     fclose(fileW);
     fclose(fileB);
 
+    if (statusA == -1 || statusW == -1 || statusB == -1) {
+        fprintf(stderr, "Error reading file %s.\n", statusA == -1 ? argv[1] : statusW == -1 ? argv[2] : argv[3]);
+        printf("Terminating, exit code 1.\n");
+        exit(1);
+    }
+
     // Print matrices
     printf("Matrix A:\n");
     printMatrix(A, 1, 3);
@@ -122,7 +106,10 @@ int main(int argc, char *argv[]) {
     printMatrix(B, 1, 5);
 
     // Perform matrix multiplication and addition
-    multiplyAndAddMatrices(A, W, B, R);
+    if (multiplyAndAddMatrices(A, W, B, R) == -1) {
+        fprintf(stderr, "Matrix multiplication failed.\n");
+        exit(1);
+    }
 
     // Print the result matrix
     printf("\nResult Matrix R:\n");
@@ -0,0 +1,530 @@
+/**
+* Description: This module benchmarks the matrix multiplication engines of this repository end to end.
+* Every engine is run as its own process on generated square matrices across a list of sizes and
+* worker counts, with warmup runs and repetitions, timed by the monotonic wall clock from fork to
+* reap so the time spent in child processes is included. The median, 95th percentile and
+* throughput of each configuration are reported as CSV or JSON.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Matrix_Common/matrix_kernels.h"
+
+#define MAX_LIST 32
+#define PATH_SIZE 4096
+
+/**
+ * One engine under test. program and helper live in directory, relative to the repository root.
+ * helper is the worker binary the program executes as "./helper", or NULL.
+ * The built-in serial engine has no program: it multiplies with gemm in a forked child.
+ */
+
+// How an engine is told its worker count
+enum {
+    WORKERS_NONE,     // the engine picks its own process or thread count
+    WORKERS_ARGUMENT, // the count follows A and W as the third argument
+    WORKERS_OPTION,   // the count is given with -j before A and W
+};
+
+typedef struct {
+    const char *name;
+    const char *directory;
+    const char *program;
+    const char *helper;
+    int fixedSize;   // the only matrix size the engine handles, or 0 for any size
+    int workerStyle; // WORKERS_NONE, WORKERS_ARGUMENT or WORKERS_OPTION
+} Engine;
+
+static const Engine engines[] = {
+    {"serial", NULL, NULL, NULL, 0, WORKERS_NONE},
+    {"fork-pipe", "Multiplication Parallel", "matrixmult_parallel", NULL, 8, WORKERS_ARGUMENT},
+    {"fork-shm", "Parallel Matrix Multiplier", "matrixmult_parallel", NULL, 0, WORKERS_NONE},
+    {"fork-exec", "Parallel Matrix Multiplier", "matrixmult_multiw", "matrixmult_parallel", 0, WORKERS_NONE},
+    {"pipe-coordinator", "Matrix_Pipe_Coordinator", "matrixmult_multiwa", "matrixmult_parallel", 0, WORKERS_OPTION},
+    {"pthread", "Threaded_Matrix_Sums", "matrixmult_multiwa", "matrixmult_threaded", 8, WORKERS_NONE},
+};
+
+#define ENGINE_COUNT ((int)(sizeof(engines) / sizeof(engines[0])))
+
+/**
+ * Benchmark settings taken from the command line.
+ */
+typedef struct {
+    int sizes[MAX_LIST];
+    int sizeCount;
+    int workers[MAX_LIST];
+    int workerCount;
+    int workersGiven; // the worker counts came from the command line
+    int selected[ENGINE_COUNT];
+    int warmup;
+    int reps;
+    int json;
+    int timeout;
+    const char *root;
+} Settings;
+
+/**
+ * Parses a comma-separated list of positive integers into values.
+ * Returns the number of values, or -1 if the list is malformed or too long.
+ */
+int parseList(const char *text, int *values) {
+    int count = 0;
+    char *copy = strdup(text);
+    char *saveptr;
+
+    for (char *token = strtok_r(copy, ",", &saveptr); token != NULL; token = strtok_r(NULL, ",", &saveptr)) {
+        char *end;
+        long value = strtol(token, &end, 10);
+        if (*end != '\0' || value < 1 || value > 1 << 20 || count == MAX_LIST) {
+            free(copy);
+            return -1;
+        }
+        values[count++] = (int)value;
+    }
+
+    free(copy);
+    return count > 0 ? count : -1;
+}
+
+/**
+ * Marks the engines named in a comma-separated list as selected.
+ * Returns 0 on success, -1 if a name is unknown.
+ */
+int selectEngines(const char *text, int *selected) {
+    char *copy = strdup(text);
+    char *saveptr;
+
+    memset(selected, 0, ENGINE_COUNT * sizeof(int));
+    for (char *token = strtok_r(copy, ",", &saveptr); token != NULL; token = strtok_r(NULL, ",", &saveptr)) {
+        int found = 0;
+        for (int i = 0; i < ENGINE_COUNT; i++) {
+            if (strcmp(token, engines[i].name) == 0) {
+                selected[i] = found = 1;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "error: unknown engine %s\n", token);
+            free(copy);
+            return -1;
+        }
+    }
+
+    free(copy);
+    return 0;
+}
+
+/**
+ * Prints the usage message to stderr.
+ */
+void printUsage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -s, --sizes LIST    matrix sizes n (A and W are n x n), default 8,64,256,512\n"
+            "  -t, --workers LIST  worker counts for fork-pipe and pipe-coordinator, default 1,2,4,8\n"
+            "  -e, --engines LIST  engines to run, default all:",
+            program);
+    for (int i = 0; i < ENGINE_COUNT; i++) {
+        fprintf(stderr, "%s%s", i == 0 ? " " : ",", engines[i].name);
+    }
+    fprintf(stderr,
+            "\n"
+            "  -w, --warmup N      untimed runs before measuring, default 1\n"
+            "  -r, --reps N        timed runs per configuration, default 5\n"
+            "  -f, --format FMT    csv or json, default csv\n"
+            "  -T, --timeout SECS  kill a run that takes longer, default 60\n"
+            "  -R, --root DIR      repository root holding the engine folders, default ..\n");
+}
+
+/**
+ * Writes an n x n matrix of small random values to path as text.
+ * Returns 0 on success, -1 on failure.
+ */
+int writeRandomMatrix(const char *path, int n) {
+    int *matrix = allocMatrix(n, n);
+    FILE *file = fopen(path, "w");
+    if (matrix == NULL || file == NULL) {
+        free(matrix);
+        if (file != NULL) {
+            fclose(file);
+        }
+        return -1;
+    }
+
+    for (size_t i = 0; i < (size_t)n * n; i++) {
+        matrix[i] = rand() % 19 - 9;
+    }
+
+    int status = writeMatrixText(file, matrix, n, n);
+    if (fclose(file) != 0) {
+        status = -1;
+    }
+    free(matrix);
+    return status;
+}
+
+/**
+ * The built-in serial engine: loads A and W, multiplies them on one thread with gemm and
+ * prints R. Returns the exit code for the child it runs in.
+ */
+int runSerial(const char *pathA, const char *pathW) {
+    MatrixView a, w;
+    if (openMatrix(pathA, &a) == -1 || openMatrix(pathW, &w) == -1 || a.cols != w.rows) {
+        return 1;
+    }
+
+    int *r = allocMatrix(a.rows, w.cols);
+    if (r == NULL || gemm(a.data, w.data, r, a.rows, a.cols, w.cols) == -1 ||
+        writeMatrixText(stdout, r, a.rows, w.cols) == -1) {
+        return 1;
+    }
+
+    free(r);
+    closeMatrix(&a);
+    closeMatrix(&w);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
+
+/**
+ * Runs an engine once on A and W inside workDir and measures its wall-clock time.
+ * workers is passed to engines that take a worker count. The engine's output is discarded.
+ * The engine runs in its own process group, which is killed if it is still running after
+ * timeout seconds. SIGCHLD must be blocked by the caller.
+ * Returns 0 if the engine exited with code 0, -1 otherwise.
+ */
+int runOnce(const Engine *engine, const char *workDir, const char *pathA, const char *pathW, int workers,
+            int timeout, double *seconds) {
+    struct timespec start, end;
+    char workerText[16];
+    snprintf(workerText, sizeof(workerText), "%d", workers);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("Fork failed");
+        return -1;
+    }
+
+    if (pid == 0) {
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        setpgid(0, 0);
+
+        int devNull = open("/dev/null", O_RDWR);
+        if (devNull == -1 || dup2(devNull, STDIN_FILENO) == -1 || dup2(devNull, STDOUT_FILENO) == -1 ||
+            dup2(devNull, STDERR_FILENO) == -1) {
+            _exit(127);
+        }
+
+        if (engine->program == NULL) {
+            _exit(runSerial(pathA, pathW));
+        }
+
+        char program[PATH_SIZE];
+        snprintf(program, sizeof(program), "./%s", engine->program);
+        if (engine->workerStyle != WORKERS_NONE) {
+            // Loading is parallelized too, so give it the same number of threads
+            setenv("MATRIX_LOAD_THREADS", workerText, 1);
+        }
+
+        char *args[6];
+        int argCount = 0;
+        args[argCount++] = program;
+        if (engine->workerStyle == WORKERS_OPTION) {
+            args[argCount++] = "-j";
+            args[argCount++] = workerText;
+        }
+        args[argCount++] = (char *)pathA;
+        args[argCount++] = (char *)pathW;
+        if (engine->workerStyle == WORKERS_ARGUMENT) {
+            args[argCount++] = workerText;
+        }
+        args[argCount] = NULL;
+        if (chdir(workDir) == 0) {
+            execv(program, args);
+        }
+        _exit(127);
+    }
+
+    setpgid(pid, pid);
+
+    // Sleep until the engine exits or the timeout passes
+    sigset_t childExited;
+    sigemptyset(&childExited);
+    sigaddset(&childExited, SIGCHLD);
+    struct timespec limit = {timeout, 0};
+    int status;
+    pid_t reaped;
+
+    while ((reaped = waitpid(pid, &status, WNOHANG)) == 0) {
+        if (sigtimedwait(&childExited, NULL, &limit) == -1 && errno == EAGAIN) {
+            fprintf(stderr, "warning: engine %s timed out after %d seconds\n", engine->name, timeout);
+            kill(-pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            return -1;
+        }
+    }
+    if (reaped == -1) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/**
+ * Links the engine's program and helper from the repository into workDir, so each engine runs
+ * in a scratch directory that also collects the PID.out / PID.err files its children write.
+ * Returns 0 on success, -1 if a binary is missing.
+ */
+int prepareEngine(const Engine *engine, const char *root, const char *workDir) {
+    const char *binaries[] = {engine->program, engine->helper};
+
+    if (mkdir(workDir, 0700) == -1) {
+        perror("Cannot create working directory");
+        return -1;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (binaries[i] == NULL) {
+            continue;
+        }
+
+        char source[PATH_SIZE], target[PATH_SIZE];
+        snprintf(source, sizeof(source), "%s/%s/%s", root, engine->directory, binaries[i]);
+        snprintf(target, sizeof(target), "%s/%s", workDir, binaries[i]);
+
+        char *absolute = realpath(source, NULL);
+        if (absolute == NULL || access(absolute, X_OK) == -1 || symlink(absolute, target) == -1) {
+            fprintf(stderr, "warning: skipping engine %s: build %s first\n", engine->name, source);
+            free(absolute);
+            return -1;
+        }
+        free(absolute);
+    }
+    return 0;
+}
+
+/**
+ * Orders doubles ascending for qsort.
+ */
+int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Prints one result row. workers is 0 for engines that do not take a worker count.
+ * samples must be sorted.
+ */
+void printResult(const Settings *settings, const char *engine, int size, int workers, const double *samples,
+                 int count, int *first) {
+    double median = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    double p95 = samples[(int)ceil(0.95 * count) - 1];
+    double gops = 2.0 * size * size * size / median / 1e9;
+
+    if (settings->json) {
+        printf("%s\n  {\"engine\": \"%s\", \"size\": %d, \"workers\": ", *first ? "" : ",", engine, size);
+        if (workers > 0) {
+            printf("%d", workers);
+        } else {
+            printf("null");
+        }
+        printf(", \"reps\": %d, \"median_s\": %.6f, \"p95_s\": %.6f, \"min_s\": %.6f, \"gops\": %.4f}", count,
+               median, p95, samples[0], gops);
+    } else {
+        printf("%s,%d,", engine, size);
+        if (workers > 0) {
+            printf("%d", workers);
+        }
+        printf(",%d,%.6f,%.6f,%.6f,%.4f\n", count, median, p95, samples[0], gops);
+    }
+    fflush(stdout);
+    *first = 0;
+}
+
+/**
+ * nftw callback that deletes every entry of the scratch directory.
+ */
+int removeEntry(const char *path, const struct stat *info, int type, struct FTW *ftw) {
+    (void)info;
+    (void)type;
+    (void)ftw;
+    return remove(path);
+}
+
+int main(int argc, char *argv[]) {
+    Settings settings = {.warmup = 1, .reps = 5, .timeout = 60, .root = ".."};
+    parseList("8,64,256,512", settings.sizes);
+    settings.sizeCount = 4;
+    parseList("1,2,4,8", settings.workers);
+    settings.workerCount = 4;
+    for (int i = 0; i < ENGINE_COUNT; i++) {
+        settings.selected[i] = 1;
+    }
+
+    static const struct option options[] = {
+        {"sizes", required_argument, NULL, 's'},   {"workers", required_argument, NULL, 't'},
+        {"engines", required_argument, NULL, 'e'}, {"warmup", required_argument, NULL, 'w'},
+        {"reps", required_argument, NULL, 'r'},    {"format", required_argument, NULL, 'f'},
+        {"timeout", required_argument, NULL, 'T'}, {"root", required_argument, NULL, 'R'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "s:t:e:w:r:f:T:R:", options, NULL)) != -1) {
+        int valid = 1;
+        switch (option) {
+        case 's':
+            valid = (settings.sizeCount = parseList(optarg, settings.sizes)) > 0;
+            break;
+        case 't':
+            valid = (settings.workerCount = parseList(optarg, settings.workers)) > 0;
+            settings.workersGiven = 1;
+            break;
+        case 'e':
+            valid = selectEngines(optarg, settings.selected) == 0;
+            break;
+        case 'w':
+            settings.warmup = atoi(optarg);
+            valid = settings.warmup >= 0;
+            break;
+        case 'r':
+            settings.reps = atoi(optarg);
+            valid = settings.reps >= 1;
+            break;
+        case 'f':
+            valid = strcmp(optarg, "csv") == 0 || strcmp(optarg, "json") == 0;
+            settings.json = strcmp(optarg, "json") == 0;
+            break;
+        case 'T':
+            settings.timeout = atoi(optarg);
+            valid = settings.timeout >= 1;
+            break;
+        case 'R':
+            settings.root = optarg;
+            break;
+        default:
+            valid = 0;
+        }
+        if (!valid) {
+            printUsage(argv[0]);
+            exit(1);
+        }
+    }
+
+    // Say which selected engines a worker list does not reach, and refuse one that reaches none
+    if (settings.workersGiven) {
+        int reached = 0;
+        for (int e = 0; e < ENGINE_COUNT; e++) {
+            if (settings.selected[e] && engines[e].workerStyle == WORKERS_NONE) {
+                fprintf(stderr, "note: engine %s picks its own worker count and ignores --workers\n", engines[e].name);
+            }
+            reached |= settings.selected[e] && engines[e].workerStyle != WORKERS_NONE;
+        }
+        if (!reached) {
+            fprintf(stderr, "error: none of the selected engines takes a worker count\n");
+            exit(1);
+        }
+    }
+
+    char scratch[] = "/tmp/matrixbench.XXXXXX";
+    if (mkdtemp(scratch) == NULL) {
+        perror("Cannot create scratch directory");
+        exit(1);
+    }
+
+    // Every engine multiplies the same generated inputs
+    srand(1);
+    for (int s = 0; s < settings.sizeCount; s++) {
+        char pathA[PATH_SIZE], pathW[PATH_SIZE];
+        snprintf(pathA, sizeof(pathA), "%s/A%d.txt", scratch, settings.sizes[s]);
+        snprintf(pathW, sizeof(pathW), "%s/W%d.txt", scratch, settings.sizes[s]);
+        if (writeRandomMatrix(pathA, settings.sizes[s]) == -1 || writeRandomMatrix(pathW, settings.sizes[s]) == -1) {
+            fprintf(stderr, "error: cannot write input matrices to %s\n", scratch);
+            nftw(scratch, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+            exit(1);
+        }
+    }
+
+    char workDirs[ENGINE_COUNT][PATH_SIZE];
+    for (int e = 0; e < ENGINE_COUNT; e++) {
+        snprintf(workDirs[e], sizeof(workDirs[e]), "%s/%s", scratch, engines[e].name);
+        if (settings.selected[e] && prepareEngine(&engines[e], settings.root, workDirs[e]) == -1) {
+            settings.selected[e] = 0;
+        }
+    }
+
+    // SIGCHLD stays blocked so runOnce can wait for it with a timeout
+    sigset_t childExited;
+    sigemptyset(&childExited);
+    sigaddset(&childExited, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childExited, NULL);
+
+    int first = 1;
+    printf(settings.json ? "[" : "engine,size,workers,reps,median_s,p95_s,min_s,gops\n");
+
+    int totalRuns = settings.warmup + settings.reps;
+    double *samples = malloc(totalRuns * sizeof(double));
+    int failures = 0;
+
+    for (int s = 0; s < settings.sizeCount; s++) {
+        const int size = settings.sizes[s];
+        char pathA[PATH_SIZE], pathW[PATH_SIZE];
+        snprintf(pathA, sizeof(pathA), "%s/A%d.txt", scratch, size);
+        snprintf(pathW, sizeof(pathW), "%s/W%d.txt", scratch, size);
+
+        for (int e = 0; e < ENGINE_COUNT; e++) {
+            const Engine *engine = &engines[e];
+            if (!settings.selected[e] || (engine->fixedSize != 0 && engine->fixedSize != size)) {
+                continue;
+            }
+
+            int workerCount = engine->workerStyle != WORKERS_NONE ? settings.workerCount : 1;
+            for (int t = 0; t < workerCount; t++) {
+                int workers = engine->workerStyle != WORKERS_NONE ? settings.workers[t] : 0;
+                int ok = 1;
+
+                for (int run = 0; run < totalRuns && ok; run++) {
+                    ok = runOnce(engine, workDirs[e], pathA, pathW, workers, settings.timeout, &samples[run]) == 0;
+                }
+
+                if (!ok) {
+                    fprintf(stderr, "warning: engine %s failed at size %d\n", engine->name, size);
+                    failures++;
+                    continue;
+                }
+
+                // Warmup runs come first and are left out of the statistics
+                qsort(samples + settings.warmup, settings.reps, sizeof(double), compareDoubles);
+                printResult(&settings, engine->name, size, workers, samples + settings.warmup, settings.reps, &first);
+            }
+        }
+    }
+
+    if (settings.json) {
+        printf("\n]\n");
+    }
+
+    free(samples);
+    nftw(scratch, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,326 @@
+/**
+* Description: Asynchronous group-commit logger for the coordinators' PID.out and PID.err status lines.
+* Callers queue formatted lines and return at once; a background flusher takes everything queued so
+* far as one batch, writes each file's lines with one write, syncs every file the batch touched once
+* and then wakes anyone waiting for the batch. MATRIX_LOG_DURABILITY picks how durable a line is:
+*   none  - lines reach the page cache in the background and are never synced
+*   batch - every batch is synced, but callers do not wait for it (default)
+*   sync  - callers wait until their line is synced, and the files are opened O_DSYNC as before
+* The flusher starts on the first line, so processes forked before then never share it.
+* Header-only so every program can keep building with a single gcc command. With glibc older
+* than 2.34, add -pthread to the gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Environment variable selecting the durability
+#define LOG_DURABILITY_ENV "MATRIX_LOG_DURABILITY"
+
+// Longest line logPrintf formats
+#define LOG_LINE_SIZE 1024
+
+typedef enum {
+    LOG_DURABILITY_NONE,
+    LOG_DURABILITY_BATCH,
+    LOG_DURABILITY_SYNC
+} LogDurability;
+
+// One queued line, or a request to close fd once everything before it is committed
+typedef struct LogRecord {
+    struct LogRecord *next;
+    int fd;
+    int closeAfter;
+    size_t length;
+    char text[];
+} LogRecord;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t pending;   // Signalled when records arrive or the log stops
+    pthread_cond_t committed; // Signalled after every batch
+    LogRecord *head;
+    LogRecord **tailLink;
+    uint64_t queued;          // Records queued so far
+    uint64_t done;            // Records written and, unless durability is none, synced
+    int stopping;
+    int started;              // The flusher thread is running
+    int error;                // errno of the first failed write or sync, 0 if none
+    LogDurability durability;
+    pthread_t flusher;
+} AsyncLog;
+
+/**
+ * Returns the durability named by MATRIX_LOG_DURABILITY, or batch when it is unset or unknown.
+ */
+static inline LogDurability logDurabilityFromEnv(void) {
+    const char *name = getenv(LOG_DURABILITY_ENV);
+    if (name != NULL && strcmp(name, "none") == 0) {
+        return LOG_DURABILITY_NONE;
+    }
+    if (name != NULL && strcmp(name, "sync") == 0) {
+        return LOG_DURABILITY_SYNC;
+    }
+    return LOG_DURABILITY_BATCH;
+}
+
+/**
+ * Prepares a log with the durability from the environment. The flusher starts with the first line.
+ */
+static inline void logInit(AsyncLog *log) {
+    memset(log, 0, sizeof(*log));
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->pending, NULL);
+    pthread_cond_init(&log->committed, NULL);
+    log->tailLink = &log->head;
+    log->durability = logDurabilityFromEnv();
+}
+
+/**
+ * Returns the extra open() flags for files whose lines the log carries: O_DSYNC with sync durability,
+ * so lines written straight to the file, such as those of an exec'ed child, stay durable per line.
+ */
+static inline int logOpenFlags(const AsyncLog *log) {
+    return log->durability == LOG_DURABILITY_SYNC ? O_DSYNC : 0;
+}
+
+/**
+ * Writes length bytes of text to fd, retrying short writes. Returns 0, or -1 with errno set.
+ */
+static inline int logWriteAll(int fd, const char *text, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, text, length);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return -1;
+        }
+        text += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+/**
+ * Writes one batch, coalescing consecutive lines for the same file into one write, then syncs each
+ * file the batch touched once and closes the files whose close was requested. Frees the records.
+ */
+static inline void logCommitBatch(AsyncLog *log, LogRecord *batch) {
+    size_t count = 0;
+    for (LogRecord *record = batch; record != NULL; record = record->next) {
+        count++;
+    }
+
+    // Files touched by the batch, each once, in first-use order
+    int *touched = malloc(count * sizeof(int));
+    size_t touchedCount = 0;
+    int error = 0;
+
+    LogRecord *record = batch;
+    while (record != NULL) {
+        // Gather the run of records for the same file
+        LogRecord *end = record;
+        size_t runLength = 0;
+        while (end != NULL && end->fd == record->fd) {
+            runLength += end->length;
+            end = end->next;
+        }
+
+        char *run = runLength > 0 ? malloc(runLength) : NULL;
+        if (run != NULL) {
+            size_t used = 0;
+            for (LogRecord *piece = record; piece != end; piece = piece->next) {
+                memcpy(run + used, piece->text, piece->length);
+                used += piece->length;
+            }
+            if (logWriteAll(record->fd, run, runLength) == -1 && error == 0) {
+                error = errno;
+            }
+            free(run);
+        } else {
+            // Out of memory: write the lines one at a time instead
+            for (LogRecord *piece = record; piece != end; piece = piece->next) {
+                if (logWriteAll(piece->fd, piece->text, piece->length) == -1 && error == 0) {
+                    error = errno;
+                }
+            }
+        }
+
+        size_t seen = 0;
+        while (touched != NULL && seen < touchedCount && touched[seen] != record->fd) {
+            seen++;
+        }
+        if (touched != NULL && seen == touchedCount) {
+            touched[touchedCount++] = record->fd;
+        }
+        record = end;
+    }
+
+    // One sync per file per batch, however many lines it carried
+    if (log->durability != LOG_DURABILITY_NONE) {
+        for (size_t i = 0; i < touchedCount; ++i) {
+            if (fdatasync(touched[i]) == -1 && errno != EINVAL && error == 0) {
+                error = errno;
+            }
+        }
+        if (touched == NULL) {
+            for (record = batch; record != NULL; record = record->next) {
+                fdatasync(record->fd);
+            }
+        }
+    }
+    free(touched);
+
+    while (batch != NULL) {
+        LogRecord *next = batch->next;
+        if (batch->closeAfter) {
+            close(batch->fd);
+        }
+        free(batch);
+        batch = next;
+    }
+
+    if (error != 0 && log->error == 0) {
+        log->error = error;
+    }
+}
+
+/**
+ * Flusher thread: commits everything queued since the last batch until the log stops.
+ */
+static inline void *logFlusher(void *argument) {
+    AsyncLog *log = argument;
+
+    pthread_mutex_lock(&log->lock);
+    while (1) {
+        while (log->head == NULL && !log->stopping) {
+            pthread_cond_wait(&log->pending, &log->lock);
+        }
+        if (log->head == NULL) {
+            break;
+        }
+
+        // Lines queued while this batch is written form the next batch
+        LogRecord *batch = log->head;
+        uint64_t last = log->queued;
+        log->head = NULL;
+        log->tailLink = &log->head;
+        pthread_mutex_unlock(&log->lock);
+
+        logCommitBatch(log, batch);
+
+        pthread_mutex_lock(&log->lock);
+        log->done = last;
+        pthread_cond_broadcast(&log->committed);
+    }
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+/**
+ * Queues a record, starting the flusher if needed, and with sync durability waits until it is
+ * committed. Without a flusher thread the record is committed on the spot. Returns 0, or -1 if the
+ * record cannot be allocated.
+ */
+static inline int logQueue(AsyncLog *log, int fd, const char *text, size_t length, int closeAfter) {
+    LogRecord *record = malloc(sizeof(LogRecord) + length);
+    if (record == NULL) {
+        return -1;
+    }
+    record->next = NULL;
+    record->fd = fd;
+    record->closeAfter = closeAfter;
+    record->length = length;
+    memcpy(record->text, text, length);
+
+    pthread_mutex_lock(&log->lock);
+    if (!log->started && !log->stopping) {
+        log->started = pthread_create(&log->flusher, NULL, logFlusher, log) == 0;
+    }
+    if (!log->started) {
+        pthread_mutex_unlock(&log->lock);
+        logCommitBatch(log, record);
+        return 0;
+    }
+
+    *log->tailLink = record;
+    log->tailLink = &record->next;
+    uint64_t sequence = ++log->queued;
+    pthread_cond_signal(&log->pending);
+
+    if (log->durability == LOG_DURABILITY_SYNC) {
+        while (log->done < sequence) {
+            pthread_cond_wait(&log->committed, &log->lock);
+        }
+    }
+    pthread_mutex_unlock(&log->lock);
+    return 0;
+}
+
+/**
+ * Queues one formatted line for fd. Returns 0, or -1 if it cannot be queued.
+ */
+__attribute__((format(printf, 3, 4)))
+static inline int logPrintf(AsyncLog *log, int fd, const char *format, ...) {
+    char line[LOG_LINE_SIZE];
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (length < 0) {
+        return -1;
+    }
+    if (length >= (int)sizeof(line)) {
+        length = sizeof(line) - 1;
+    }
+    return logQueue(log, fd, line, (size_t)length, 0);
+}
+
+/**
+ * Hands fd to the log, which closes it once every line queued before it is committed.
+ * The caller must not use fd afterwards.
+ */
+static inline void logCloseFile(AsyncLog *log, int fd) {
+    if (fd != -1 && logQueue(log, fd, "", 0, 1) == -1) {
+        close(fd);
+    }
+}
+
+/**
+ * Commits every queued line and stops the flusher. Returns 0, or -1 with errno set to the first
+ * write or sync error.
+ */
+static inline int logShutdown(AsyncLog *log) {
+    pthread_mutex_lock(&log->lock);
+    log->stopping = 1;
+    int started = log->started;
+    pthread_cond_signal(&log->pending);
+    pthread_mutex_unlock(&log->lock);
+
+    if (started) {
+        pthread_join(log->flusher, NULL);
+        log->started = 0;
+    }
+    if (log->error != 0) {
+        errno = log->error;
+        return -1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,278 @@
+/**
+* Description: Single-producer single-consumer ring of fixed-size job descriptors in shared memory.
+* A coordinator hands A matrix file names to a child through it without a syscall per job.
+* The ring lives in a memfd so it survives execv: the coordinator creates it before forking, the
+* child keeps it with shareJobRing and maps it again from the descriptor named by MATRIX_RING_FD.
+* The producer never blocks: tryPushJob fails with EAGAIN on a full ring, and the consumer then
+* signals the ring's eventfd once it frees room, so the producer can wait on many rings in one
+* epoll or poll call. A consumer that finds the ring empty spins first and only then sleeps on a
+* futex. Each side makes the wake-up syscall only when it sees the other waiting, so a busy ring
+* costs no syscalls.
+* A name longer than one descriptor continues in the descriptors after it.
+* A descriptor of length 0 ends the stream, like the 0 length sent over the pipes.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef JOB_RING_H
+#define JOB_RING_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Environment variable naming the ring descriptor a child inherits
+#define JOB_RING_ENV "MATRIX_RING_FD"
+
+// Descriptors in flight per ring; a power of two
+#define JOB_RING_SLOTS 1024
+
+// Name bytes carried by one descriptor, sized so a descriptor fills four cache lines
+#define JOB_PATH_SIZE 252
+
+// Times the consumer polls an empty ring before it sleeps, when there is more than one CPU
+#define JOB_RING_SPIN 4000
+
+// How often a waiting side wakes to check that its peer is still alive
+#define JOB_RING_POLL_MS 50
+
+// memfd_create flag, spelled out so no feature-test macro is needed
+#define JOB_RING_MFD_CLOEXEC 0x0001U
+
+// One job, or one piece of a long name: length is the whole name's, without a terminating NUL
+typedef struct {
+    uint32_t length;
+    char path[JOB_PATH_SIZE];
+} JobDescriptor;
+
+_Static_assert(sizeof(JobDescriptor) % CACHE_LINE_SIZE == 0, "JobDescriptor must fill whole cache lines");
+
+// Each index shares its cache line only with the flag its owner writes next to it
+typedef struct {
+    pid_t producer;                             // Process that created the ring
+    int spaceEvent;                             // eventfd signalled when room frees up for a waiting producer
+    _Alignas(CACHE_LINE_SIZE) atomic_uint head; // Descriptors published; written by the producer
+    atomic_uint producerWaiting;                // Set while the producer waits for room
+    _Alignas(CACHE_LINE_SIZE) atomic_uint tail; // Descriptors consumed; written by the consumer
+    atomic_uint consumerWaiting;                // Set while the consumer sleeps on an empty ring
+    _Alignas(CACHE_LINE_SIZE) JobDescriptor slots[JOB_RING_SLOTS];
+} JobRing;
+
+/**
+ * Sleeps until *word no longer holds expected, a wake-up arrives or timeoutMs passes.
+ */
+static inline void futexWait(atomic_uint *word, unsigned expected, int timeoutMs) {
+    struct timespec timeout = {timeoutMs / 1000, (long)(timeoutMs % 1000) * 1000000L};
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+/**
+ * Wakes the process sleeping on *word, if any.
+ */
+static inline void futexWake(atomic_uint *word) {
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/**
+ * Returns 0 once process pid has exited, even if it is an unreaped child of the caller, and 1 otherwise.
+ */
+static inline int peerAlive(pid_t pid) {
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    if (waitid(P_PID, (id_t)pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid) {
+        return 0;
+    }
+    return !(kill(pid, 0) == -1 && errno == ESRCH);
+}
+
+/**
+ * Returns how many times to poll before sleeping. With one CPU the peer cannot run while we poll,
+ * so polling only delays it.
+ */
+static inline int jobRingSpinLimit(void) {
+    static int limit = -1;
+    if (limit == -1) {
+        limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? JOB_RING_SPIN : 0;
+    }
+    return limit;
+}
+
+/**
+ * Creates a ring in a new memfd, whose descriptor is stored in *fd. Both the memfd and the ring's
+ * eventfd are closed on exec unless shareJobRing is called. Returns NULL if the ring cannot be created.
+ */
+static inline JobRing *createJobRing(int *fd) {
+    *fd = (int)syscall(SYS_memfd_create, "matrix-job-ring", JOB_RING_MFD_CLOEXEC);
+    if (*fd == -1) {
+        return NULL;
+    }
+
+    JobRing *ring = NULL;
+    int spaceEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (spaceEvent != -1 && ftruncate(*fd, sizeof(JobRing)) == 0) {
+        ring = mmap(NULL, sizeof(JobRing), PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    }
+    if (ring == NULL || ring == MAP_FAILED) {
+        if (spaceEvent != -1) {
+            close(spaceEvent);
+        }
+        close(*fd);
+        *fd = -1;
+        return NULL;
+    }
+    ring->producer = getpid();
+    ring->spaceEvent = spaceEvent;
+    return ring;
+}
+
+/**
+ * Called in a forked child before execv: keeps the ring's descriptors open across exec and names
+ * the memfd in MATRIX_RING_FD. The eventfd keeps its number, which the ring already records.
+ * Returns 0, or -1 on failure.
+ */
+static inline int shareJobRing(const JobRing *ring, int fd) {
+    char name[12];
+    snprintf(name, sizeof(name), "%d", fd);
+    if (fcntl(fd, F_SETFD, 0) == -1 || fcntl(ring->spaceEvent, F_SETFD, 0) == -1) {
+        return -1;
+    }
+    return setenv(JOB_RING_ENV, name, 1);
+}
+
+/**
+ * Maps the ring whose descriptor is named by MATRIX_RING_FD and closes the descriptor. Returns NULL
+ * when the variable is not set or the ring cannot be mapped, in which case the caller reads the pipe.
+ */
+static inline JobRing *attachJobRing(void) {
+    const char *name = getenv(JOB_RING_ENV);
+    if (name == NULL || *name == '\0') {
+        return NULL;
+    }
+
+    int fd = atoi(name);
+    JobRing *ring = mmap(NULL, sizeof(JobRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return ring == MAP_FAILED ? NULL : ring;
+}
+
+/**
+ * Unmaps a ring and closes this process's copy of its eventfd.
+ */
+static inline void unmapJobRing(JobRing *ring) {
+    if (ring != NULL) {
+        close(ring->spaceEvent);
+        munmap(ring, sizeof(JobRing));
+    }
+}
+
+/**
+ * Returns the descriptors a name of length bytes occupies; the end-of-stream marker takes one.
+ */
+static inline unsigned jobSlots(size_t length) {
+    return length == 0 ? 1 : (unsigned)((length + JOB_PATH_SIZE - 1) / JOB_PATH_SIZE);
+}
+
+/**
+ * Publishes one job without waiting. A length of 0 ends the stream. Returns 0, or -1 with errno set
+ * to EAGAIN if the ring is full, in which case the consumer signals spaceEvent once it frees room,
+ * or to ENAMETOOLONG.
+ */
+static inline int tryPushJob(JobRing *ring, const char *path, size_t length) {
+    if (length >= PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    const unsigned needed = jobSlots(length);
+    const unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (JOB_RING_SLOTS - (head - tail) < needed) {
+        // Ask for the signal before the last look, so a consumer that frees room sees the flag
+        atomic_store(&ring->producerWaiting, 1);
+        tail = atomic_load(&ring->tail);
+        if (JOB_RING_SLOTS - (head - tail) < needed) {
+            errno = EAGAIN;
+            return -1;
+        }
+        atomic_store_explicit(&ring->producerWaiting, 0, memory_order_relaxed);
+    }
+
+    for (unsigned i = 0; i < needed; ++i) {
+        JobDescriptor *slot = &ring->slots[(head + i) % JOB_RING_SLOTS];
+        const size_t offset = (size_t)i * JOB_PATH_SIZE;
+        slot->length = (uint32_t)length;
+        memcpy(slot->path, path + offset, length - offset < JOB_PATH_SIZE ? length - offset : JOB_PATH_SIZE);
+    }
+
+    // Sequentially consistent so the store and the load of consumerWaiting cannot pass each other
+    atomic_store(&ring->head, head + needed);
+    if (atomic_load(&ring->consumerWaiting)) {
+        futexWake(&ring->head);
+    }
+    return 0;
+}
+
+/**
+ * Takes the next job into path, which holds PATH_MAX bytes, and NUL-terminates it, waiting while the
+ * ring is empty. Returns the name length, 0 at the end of the stream, or -1 if the producer has exited.
+ */
+static inline int popJob(JobRing *ring, char *path) {
+    const unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    for (int spin = 0; head == tail; ++spin) {
+        if (spin >= jobRingSpinLimit()) {
+            // Announce the sleep before the last look, so a producer that publishes sees the flag
+            atomic_store(&ring->consumerWaiting, 1);
+            head = atomic_load(&ring->head);
+            if (head == tail) {
+                futexWait(&ring->head, head, JOB_RING_POLL_MS);
+            }
+            atomic_store_explicit(&ring->consumerWaiting, 0, memory_order_relaxed);
+            if (atomic_load_explicit(&ring->head, memory_order_acquire) == tail && !peerAlive(ring->producer)) {
+                return -1;
+            }
+        }
+        head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    }
+
+    // Every piece of a name is published by the same store of head
+    uint32_t length = ring->slots[tail % JOB_RING_SLOTS].length;
+    if (length >= PATH_MAX) {
+        length = PATH_MAX - 1;
+    }
+    const unsigned needed = jobSlots(length);
+    for (unsigned i = 0; i < needed; ++i) {
+        const JobDescriptor *slot = &ring->slots[(tail + i) % JOB_RING_SLOTS];
+        const size_t offset = (size_t)i * JOB_PATH_SIZE;
+        memcpy(path + offset, slot->path, length - offset < JOB_PATH_SIZE ? length - offset : JOB_PATH_SIZE);
+    }
+    path[length] = '\0';
+
+    // Sequentially consistent so the store and the exchange of producerWaiting cannot pass each other
+    atomic_store(&ring->tail, tail + needed);
+    if (atomic_exchange(&ring->producerWaiting, 0)) {
+        const uint64_t one = 1;
+        if (write(ring->spaceEvent, &one, sizeof(one)) == -1) {
+            // A full counter already wakes the producer
+        }
+    }
+    return (int)length;
+}
+
+#endif
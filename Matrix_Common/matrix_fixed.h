@@ -0,0 +1,121 @@
+/**
+* Description: Shape-specialized integer matrix multiplication for small fixed shapes.
+* Each kernel is generated with its M, K and N as compile-time constants so the compiler fully
+* unrolls and vectorizes it, with no packing, blocking or bounds bookkeeping. A lookup table maps
+* the common shapes to their kernel and every other shape falls back to the generic gemm.
+* On x86 each kernel is built for every instruction set of matrix_kernels.h, and the one in use
+* there, including a narrower set forced with MATRIX_KERNEL, is the one called.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef MATRIX_FIXED_H
+#define MATRIX_FIXED_H
+
+#include <string.h>
+
+#include "matrix_kernels.h"
+
+/**
+ * A kernel for one fixed shape: R (M x N) = A (M x K) * W (K x N), all densely stored row-major.
+ */
+typedef void (*FixedGemm)(const int *A, const int *W, int *R);
+
+/**
+ * Defines gemmFixed_MxKxN_SUFFIX for one instruction set. The loops only have constant bounds,
+ * so at -O2 each kernel becomes straight-line (vectorized) code.
+ */
+#define DEFINE_FIXED_GEMM_FOR(M, K, N, SUFFIX, TARGET)                                     \
+    TARGET                                                                                 \
+    static void gemmFixed_##M##x##K##x##N##_##SUFFIX(const int *A, const int *W, int *R) { \
+        for (int i = 0; i < (M); i++) {                                                    \
+            int row[(N)] = {0};                                                            \
+            _Pragma("GCC unroll 16")                                                       \
+            for (int k = 0; k < (K); k++) {                                                \
+                const int aValue = A[i * (K) + k];                                         \
+                for (int j = 0; j < (N); j++) {                                            \
+                    row[j] += aValue * W[k * (N) + j];                                     \
+                }                                                                          \
+            }                                                                              \
+            memcpy(R + i * (N), row, sizeof(row));                                         \
+        }                                                                                  \
+    }
+
+/**
+ * Defines the kernels of one shape, and FIXED_GEMM_ENTRY lists them in matrixKernels.level order
+ * for fixedGemmTable. On x86 there is one per instruction set of matrix_kernels.h.
+ */
+#ifdef MATRIX_KERNELS_X86
+#define DEFINE_FIXED_GEMM(M, K, N)                                                           \
+    DEFINE_FIXED_GEMM_FOR(M, K, N, scalar, )                                                 \
+    DEFINE_FIXED_GEMM_FOR(M, K, N, sse41, __attribute__((target("sse4.1"))))                \
+    DEFINE_FIXED_GEMM_FOR(M, K, N, avx2, __attribute__((target("avx2"))))                   \
+    DEFINE_FIXED_GEMM_FOR(M, K, N, avx512, __attribute__((target("avx512f"))))
+#define FIXED_GEMM_ENTRY(M, K, N)                                                            \
+    {M, K, N, {gemmFixed_##M##x##K##x##N##_scalar, gemmFixed_##M##x##K##x##N##_sse41,        \
+               gemmFixed_##M##x##K##x##N##_avx2, gemmFixed_##M##x##K##x##N##_avx512}}
+#else
+#define DEFINE_FIXED_GEMM(M, K, N) DEFINE_FIXED_GEMM_FOR(M, K, N, scalar, )
+#define FIXED_GEMM_ENTRY(M, K, N)                                                            \
+    {M, K, N, {gemmFixed_##M##x##K##x##N##_scalar, gemmFixed_##M##x##K##x##N##_scalar,       \
+               gemmFixed_##M##x##K##x##N##_scalar, gemmFixed_##M##x##K##x##N##_scalar}}
+#endif
+
+DEFINE_FIXED_GEMM(1, 3, 5)
+DEFINE_FIXED_GEMM(1, 4, 4)
+DEFINE_FIXED_GEMM(1, 8, 8)
+DEFINE_FIXED_GEMM(1, 16, 16)
+DEFINE_FIXED_GEMM(4, 4, 4)
+DEFINE_FIXED_GEMM(8, 8, 8)
+DEFINE_FIXED_GEMM(16, 16, 16)
+DEFINE_FIXED_GEMM(32, 32, 32)
+
+/**
+ * Shapes with a specialized kernel. Add a DEFINE_FIXED_GEMM line and an entry here to support another.
+ */
+static const struct {
+    int m;
+    int k;
+    int n;
+    FixedGemm kernels[4]; // Indexed by matrixKernels.level
+} fixedGemmTable[] = {
+    FIXED_GEMM_ENTRY(1, 3, 5),
+    FIXED_GEMM_ENTRY(1, 4, 4),
+    FIXED_GEMM_ENTRY(1, 8, 8),
+    FIXED_GEMM_ENTRY(1, 16, 16),
+    FIXED_GEMM_ENTRY(4, 4, 4),
+    FIXED_GEMM_ENTRY(8, 8, 8),
+    FIXED_GEMM_ENTRY(16, 16, 16),
+    FIXED_GEMM_ENTRY(32, 32, 32),
+};
+
+/**
+ * Returns the specialized kernel for an m x k by k x n product, built for the instruction set in
+ * use, or NULL if there is none. Callers that multiply the same shape many times can look the
+ * kernel up once.
+ */
+static inline FixedGemm lookupFixedGemm(int m, int k, int n) {
+    for (size_t i = 0; i < sizeof(fixedGemmTable) / sizeof(fixedGemmTable[0]); i++) {
+        if (fixedGemmTable[i].m == m && fixedGemmTable[i].k == k && fixedGemmTable[i].n == n) {
+            return fixedGemmTable[i].kernels[matrixKernels.level];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * R (m x n) = A (m x k) * W (k x n), all densely stored row-major.
+ * Uses the specialized kernel for the shape when there is one, otherwise the generic gemm.
+ * Returns 0 on success, -1 if the generic kernel could not allocate memory.
+ */
+static inline int gemmShape(const int *A, const int *W, int *R, int m, int k, int n) {
+    FixedGemm kernel = lookupFixedGemm(m, k, n);
+    if (kernel != NULL) {
+        kernel(A, W, R);
+        return 0;
+    }
+    return gemm(A, W, R, m, k, n);
+}
+
+#endif
@@ -0,0 +1,807 @@
+/**
+* Description: Shared helpers for loading matrices whose dimensions are only known at runtime.
+* Matrices are stored row-major in heap buffers aligned to a cache line, and text files of any
+* width or height are measured before they are read so nothing is silently truncated.
+* Text is parsed in large blocks with a word-at-a-time digit scanner, and malformed values are
+* reported with their line and column. Large text files are split at newlines and parsed by one
+* thread per CPU, each writing straight into its own rows. Every reader also accepts the binary
+* matrix format (a MatrixFileHeader followed by raw row-major int32 values), detected by sniffing
+* the header; binary files are read through mmap. Pipes are not sniffed, since they cannot be rewound,
+* and are always read as text.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef MATRIX_IO_H
+#define MATRIX_IO_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Matrices smaller than the original fixed 8x8 are zero-padded up to it so existing outputs are unchanged
+#define MIN_MATRIX_DIM 8
+
+// Binary matrix files start with this magic, followed by the rest of MatrixFileHeader
+#define MATRIX_FILE_MAGIC "MTXB"
+#define MATRIX_FILE_VERSION 1
+
+// Element types of a binary matrix file
+#define MATRIX_ELEMENT_INT32 1
+
+/**
+ * Header of a binary matrix file. The fields and the values are in the byte order of the machine
+ * that wrote the file (little-endian on x86-64 and AArch64), so the values can be used in place
+ * from the mapping; a file is not portable to a machine of the other byte order. The header is one
+ * cache line, and the row-major values start at dataOffset, which is a multiple of alignment and
+ * of the size of a value.
+ */
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t elementType;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t alignment;
+    uint32_t dataOffset;
+    uint8_t reserved[40];
+} MatrixFileHeader;
+
+_Static_assert(sizeof(MatrixFileHeader) == CACHE_LINE_SIZE, "MatrixFileHeader must be one cache line");
+
+/**
+ * A read-only matrix loaded by openMatrix. For binary files data points straight into the
+ * file mapping; for text files it points at a heap copy.
+ */
+typedef struct {
+    int rows;
+    int cols;
+    const int *data;
+    void *mapping;
+    size_t mappingSize;
+} MatrixView;
+
+/**
+ * Returns the larger of a and b.
+ */
+static inline int maxDim(int a, int b) {
+    return a > b ? a : b;
+}
+
+/**
+ * Rounds a byte count up to a whole number of cache lines.
+ */
+static inline size_t cacheLineRound(size_t bytes) {
+    return (bytes + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+}
+
+/**
+ * Allocates a zero-filled rows x cols int matrix aligned to a cache line.
+ * Returns NULL if the allocation fails. Release with free().
+ */
+static inline int *allocMatrix(int rows, int cols) {
+    size_t bytes = cacheLineRound((size_t)rows * cols * sizeof(int));
+    if (bytes == 0) {
+        bytes = CACHE_LINE_SIZE;
+    }
+
+    int *matrix = aligned_alloc(CACHE_LINE_SIZE, bytes);
+    if (matrix != NULL) {
+        memset(matrix, 0, bytes);
+    }
+    return matrix;
+}
+
+/**
+ * Checks whether file starts with a binary matrix header and, if so, validates it into header.
+ * Returns 1 for a valid binary file, 0 for a text file and -1 for a damaged or unsupported
+ * binary file, or one that cannot be rewound. The file position is left at the start.
+ * A file that cannot seek, such as a pipe, is not read at all and counts as text, so none of
+ * its bytes are lost.
+ */
+static inline int sniffMatrixFile(FILE *file, MatrixFileHeader *header) {
+    if (ftell(file) == -1) {
+        return 0;
+    }
+
+    size_t got = fread(header, 1, sizeof(*header), file);
+    if (fseek(file, 0, SEEK_SET) == -1) {
+        fprintf(stderr, "error: cannot rewind matrix file\n");
+        return -1;
+    }
+
+    if (got < sizeof(header->magic) || memcmp(header->magic, MATRIX_FILE_MAGIC, sizeof(header->magic)) != 0) {
+        return 0;
+    }
+
+    struct stat info;
+    if (got != sizeof(*header) || header->version != MATRIX_FILE_VERSION ||
+        header->elementType != MATRIX_ELEMENT_INT32 || header->rows > INT32_MAX || header->cols > INT32_MAX ||
+        header->dataOffset < sizeof(*header) || header->alignment == 0 || header->dataOffset % header->alignment != 0 ||
+        header->dataOffset % sizeof(int32_t) != 0 || fstat(fileno(file), &info) == -1 ||
+        (uint64_t)info.st_size < header->dataOffset + (uint64_t)header->rows * header->cols * sizeof(int32_t)) {
+        fprintf(stderr, "error: damaged or unsupported binary matrix file\n");
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * Maps the whole of a binary matrix file read-only.
+ * Returns the mapping or NULL on failure; mappingSize receives its length.
+ */
+static inline void *mapMatrixFile(FILE *file, size_t *mappingSize) {
+    struct stat info;
+    if (fstat(fileno(file), &info) == -1 || info.st_size == 0) {
+        return NULL;
+    }
+
+    void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    *mappingSize = info.st_size;
+    return mapping;
+}
+
+// Text files are read and parsed in blocks of this many bytes
+#define MATRIX_PARSE_BLOCK (1 << 20)
+
+// Text files at least this large are split into chunks and parsed by several threads
+#define MATRIX_PARALLEL_MIN_BYTES (4 * MATRIX_PARSE_BLOCK)
+
+// Upper bound on the threads used to parse one file
+#define MATRIX_MAX_LOAD_THREADS 64
+
+// Byte classes of the text parser
+enum {
+    MATRIX_CHAR_INVALID,
+    MATRIX_CHAR_SPACE,
+    MATRIX_CHAR_NEWLINE,
+    MATRIX_CHAR_DIGIT,
+    MATRIX_CHAR_SIGN
+};
+
+static const unsigned char matrixCharClass[256] = {
+    [' '] = MATRIX_CHAR_SPACE,
+    ['\t'] = MATRIX_CHAR_SPACE,
+    ['\r'] = MATRIX_CHAR_SPACE,
+    ['\n'] = MATRIX_CHAR_NEWLINE,
+    ['0' ... '9'] = MATRIX_CHAR_DIGIT,
+    ['+'] = MATRIX_CHAR_SIGN,
+    ['-'] = MATRIX_CHAR_SIGN,
+};
+
+static const uint32_t matrixPowersOf10[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+/**
+ * Progress of a text parse over one or more consecutive ranges of a file.
+ */
+typedef struct {
+    int *matrix;            // destination, or NULL when only measuring
+    int rows;
+    int cols;
+    int measuring;          // when 0, parsing stops once row reaches rows
+    int row;                // current line, counted from the destination's first row
+    int col;                // values seen so far on the current line
+    int lastRow;            // lines up to the last one holding a value
+    int widest;             // most values on one line
+    int done;
+    const char *problem;    // set on malformed input
+    uint64_t lineOffset;    // file offset of the current line
+    uint64_t problemOffset; // file offset of the malformed input
+} TextParse;
+
+/**
+ * Loads 8 bytes so that the byte at p is the least significant one. Bytes at or past end,
+ * the end of readable memory, are loaded as 0.
+ */
+static inline uint64_t loadTextWord(const unsigned char *p, const unsigned char *end) {
+    uint64_t word = 0;
+    memcpy(&word, p, end - p >= (ptrdiff_t)sizeof(word) ? sizeof(word) : (size_t)(end - p));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+/**
+ * Returns how many of the 8 bytes of word, in memory order, are ASCII digits before the first
+ * byte that is not. All 8 bytes are tested at once: a byte is a digit when its high nibble is 3
+ * both before and after adding 6.
+ */
+static inline int digitRunLength(uint64_t word) {
+    const uint64_t highNibbles = 0xF0F0F0F0F0F0F0F0ULL;
+    const uint64_t digitNibbles = 0x3030303030303030ULL;
+    uint64_t notDigit = ((word & highNibbles) ^ digitNibbles) |
+                        (((word + 0x0606060606060606ULL) & highNibbles) ^ digitNibbles);
+    return notDigit == 0 ? 8 : __builtin_ctzll(notDigit) >> 3;
+}
+
+/**
+ * Returns the value of the first count (1 to 8) ASCII digits of word, combining pairs of
+ * digits, then pairs of pairs, with three multiplies.
+ */
+static inline uint32_t parseDigitRun(uint64_t word, int count) {
+    word = (word & 0x0F0F0F0F0F0F0F0FULL) << (8 * (8 - count));
+    word = (word * 2561) >> 8;
+    word = ((word & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+    return (uint32_t)(((word & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32);
+}
+
+/**
+ * Parses the text in [start, limit), which begins at file offset startOffset, continuing the
+ * parse state in parse. limit must fall between values; memory up to end may be read.
+ * Stops early on malformed input, recorded in parse->problem, or once parse->done is set.
+ */
+static inline void parseTextRange(TextParse *parse, const unsigned char *start, const unsigned char *limit,
+                                  const unsigned char *end, uint64_t startOffset) {
+    const unsigned char *p = start;
+    int row = parse->row;
+    int col = parse->col;
+
+    while (p < limit) {
+        switch (matrixCharClass[*p]) {
+        case MATRIX_CHAR_SPACE:
+            p++;
+            break;
+
+        case MATRIX_CHAR_NEWLINE:
+            if (col > 0) {
+                parse->lastRow = row + 1;
+                parse->widest = maxDim(parse->widest, col);
+            }
+            row++;
+            col = 0;
+            p++;
+            parse->lineOffset = startOffset + (p - start);
+            if (!parse->measuring && row >= parse->rows) {
+                parse->done = 1;
+                p = limit;
+            }
+            break;
+
+        case MATRIX_CHAR_DIGIT:
+        case MATRIX_CHAR_SIGN: {
+            const unsigned char *token = p;
+            const int negative = *p == '-';
+            p += matrixCharClass[*p] == MATRIX_CHAR_SIGN;
+
+            // Consume up to 8 digits per step; a value ends at the first non-digit
+            const unsigned char *digits = p;
+            int64_t value = 0;
+            int run;
+            do {
+                uint64_t word = loadTextWord(p, end);
+                run = digitRunLength(word);
+                if (run > 0) {
+                    value = value * matrixPowersOf10[run] + parseDigitRun(word, run);
+                    p += run;
+                }
+            } while (run == 8 && value <= (int64_t)INT32_MAX + 1);
+
+            if (p == digits || (p < limit && matrixCharClass[*p] != MATRIX_CHAR_SPACE &&
+                                matrixCharClass[*p] != MATRIX_CHAR_NEWLINE)) {
+                parse->problem = "malformed value";
+            } else if (value > (int64_t)INT32_MAX + negative) {
+                parse->problem = "value out of range";
+                p = token;
+            }
+            if (parse->problem != NULL) {
+                parse->problemOffset = startOffset + (p - start);
+                p = limit;
+                break;
+            }
+
+            if (parse->matrix != NULL && row < parse->rows && col < parse->cols) {
+                parse->matrix[(size_t)row * parse->cols + col] = (int)(negative ? -value : value);
+            }
+            col++;
+            break;
+        }
+
+        default:
+            parse->problem = "unexpected character";
+            parse->problemOffset = startOffset + (p - start);
+            p = limit;
+            break;
+        }
+    }
+
+    parse->row = row;
+    parse->col = col;
+}
+
+/**
+ * Ends a parse at the end of the file; the last line need not end with a newline.
+ */
+static inline void finishTextParse(TextParse *parse) {
+    if (parse->col > 0) {
+        parse->lastRow = parse->row + 1;
+        parse->widest = maxDim(parse->widest, parse->col);
+    }
+}
+
+/**
+ * Parses a whole text file with one thread, reading it in MATRIX_PARSE_BLOCK blocks, so it
+ * also works on pipes. Returns 0 when the file was read (check parse->problem), -1 on a read error.
+ */
+static inline int parseTextStream(FILE *file, TextParse *parse) {
+    unsigned char *buffer = malloc(MATRIX_PARSE_BLOCK);
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    uint64_t bufferOffset = 0;
+    size_t carried = 0;
+
+    for (;;) {
+        size_t wanted = MATRIX_PARSE_BLOCK - carried;
+        size_t got = fread(buffer + carried, 1, wanted, file);
+        size_t length = carried + got;
+        int atEnd = got < wanted;
+
+        if (atEnd && ferror(file)) {
+            free(buffer);
+            return -1;
+        }
+
+        // Stop this block after its last separator so no value is split between blocks
+        size_t end = length;
+        if (!atEnd) {
+            while (end > 0 && matrixCharClass[buffer[end - 1]] != MATRIX_CHAR_SPACE &&
+                   matrixCharClass[buffer[end - 1]] != MATRIX_CHAR_NEWLINE) {
+                end--;
+            }
+            if (end == 0) {
+                parse->problem = "value too long";
+                parse->problemOffset = bufferOffset;
+                break;
+            }
+        }
+
+        parseTextRange(parse, buffer, buffer + end, buffer + length, bufferOffset);
+        if (parse->problem != NULL || parse->done) {
+            break;
+        }
+        if (atEnd) {
+            finishTextParse(parse);
+            break;
+        }
+
+        carried = length - end;
+        memmove(buffer, buffer + end, carried);
+        bufferOffset += end;
+    }
+
+    free(buffer);
+    return 0;
+}
+
+/**
+ * One newline-aligned byte range of a mapped text file, parsed by one thread.
+ */
+typedef struct {
+    TextParse parse;
+    const unsigned char *start;
+    const unsigned char *limit;
+    const unsigned char *end;
+    uint64_t startOffset;
+    int countOnly; // only count the lines, into parse.row
+    pthread_t thread;
+} TextChunk;
+
+/**
+ * Thread entry point: parses, or only counts the lines of, one TextChunk.
+ */
+static inline void *parseTextChunk(void *arg) {
+    TextChunk *chunk = arg;
+
+    if (chunk->countOnly) {
+        const unsigned char *p = chunk->start;
+        while ((p = memchr(p, '\n', chunk->limit - p)) != NULL) {
+            chunk->parse.row++;
+            p++;
+        }
+        return NULL;
+    }
+
+    parseTextRange(&chunk->parse, chunk->start, chunk->limit, chunk->end, chunk->startOffset);
+    if (chunk->limit == chunk->end && chunk->parse.problem == NULL && !chunk->parse.done) {
+        finishTextParse(&chunk->parse);
+    }
+    return NULL;
+}
+
+/**
+ * Runs parseTextChunk on every chunk concurrently and waits for them. A chunk whose thread
+ * cannot be started is parsed by the calling thread instead.
+ */
+static inline void runTextChunks(TextChunk *chunks, int count) {
+    int started[MATRIX_MAX_LOAD_THREADS] = {0};
+
+    for (int i = 1; i < count; i++) {
+        started[i] = pthread_create(&chunks[i].thread, NULL, parseTextChunk, &chunks[i]) == 0;
+    }
+    parseTextChunk(&chunks[0]);
+    for (int i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(chunks[i].thread, NULL);
+        } else {
+            parseTextChunk(&chunks[i]);
+        }
+    }
+}
+
+/**
+ * Returns the number of threads used to parse a large text file: MATRIX_LOAD_THREADS if set,
+ * otherwise one per online CPU.
+ */
+static inline int matrixLoadThreads(void) {
+    const char *forced = getenv("MATRIX_LOAD_THREADS");
+    long threads = forced != NULL ? strtol(forced, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (threads < 1) {
+        return 1;
+    }
+    return threads > MATRIX_MAX_LOAD_THREADS ? MATRIX_MAX_LOAD_THREADS : (int)threads;
+}
+
+/**
+ * Parses a large regular text file with up to threads threads. The file is mapped and split
+ * at newlines into one chunk per thread. A first pass measures every chunk, or when reading
+ * only counts its lines, which gives each chunk the row it starts on; when reading, a second
+ * pass parses every chunk straight into its own rows of parse->matrix.
+ * Returns 0 when the file was parsed (check parse->problem), 1 if it is not a regular file
+ * large enough to split and must be streamed instead.
+ */
+static inline int parseTextParallel(FILE *file, TextParse *parse, int threads) {
+    struct stat info;
+    if (fstat(fileno(file), &info) == -1 || !S_ISREG(info.st_mode) || info.st_size < MATRIX_PARALLEL_MIN_BYTES) {
+        return 1;
+    }
+
+    const size_t size = info.st_size;
+    unsigned char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (data == MAP_FAILED) {
+        return 1;
+    }
+
+    TextChunk chunks[MATRIX_MAX_LOAD_THREADS];
+    int firstRows[MATRIX_MAX_LOAD_THREADS];
+    const unsigned char *end = data + size;
+    const unsigned char *start = data;
+    const int count = (size_t)threads < size / MATRIX_PARSE_BLOCK ? threads : (int)(size / MATRIX_PARSE_BLOCK);
+
+    for (int i = 0; i < count; i++) {
+        const unsigned char *limit = end;
+        if (i < count - 1) {
+            limit = data + size / count * (i + 1);
+            if (limit < start) {
+                limit = start;
+            }
+            const unsigned char *newline = limit < end ? memchr(limit, '\n', end - limit) : NULL;
+            limit = newline != NULL ? newline + 1 : end;
+        }
+
+        memset(&chunks[i], 0, sizeof(chunks[i]));
+        chunks[i].parse.measuring = 1;
+        chunks[i].parse.lineOffset = start - data;
+        chunks[i].start = start;
+        chunks[i].limit = limit;
+        chunks[i].end = end;
+        chunks[i].startOffset = start - data;
+        chunks[i].countOnly = !parse->measuring;
+        start = limit;
+    }
+
+    runTextChunks(chunks, count);
+
+    for (int i = 0; i < count; i++) {
+        firstRows[i] = parse->row;
+        if (chunks[i].parse.problem != NULL) {
+            parse->problem = chunks[i].parse.problem;
+            parse->problemOffset = chunks[i].parse.problemOffset;
+            parse->lineOffset = chunks[i].parse.lineOffset;
+            parse->row += chunks[i].parse.row;
+            break;
+        }
+        if (chunks[i].parse.lastRow > 0) {
+            parse->lastRow = firstRows[i] + chunks[i].parse.lastRow;
+        }
+        parse->widest = maxDim(parse->widest, chunks[i].parse.widest);
+        parse->row += chunks[i].parse.row;
+    }
+
+    if (!parse->measuring) {
+        for (int i = 0; i < count; i++) {
+            TextParse *chunkParse = &chunks[i].parse;
+            memset(chunkParse, 0, sizeof(*chunkParse));
+            chunkParse->matrix = parse->matrix;
+            chunkParse->rows = parse->rows;
+            chunkParse->cols = parse->cols;
+            chunkParse->row = firstRows[i];
+            chunkParse->lineOffset = chunks[i].startOffset;
+            chunks[i].countOnly = 0;
+            if (firstRows[i] >= parse->rows) {
+                chunks[i].limit = chunks[i].start;
+            }
+        }
+
+        runTextChunks(chunks, count);
+
+        for (int i = 0; i < count; i++) {
+            if (chunks[i].parse.problem != NULL) {
+                *parse = chunks[i].parse;
+                break;
+            }
+        }
+    }
+
+    munmap(data, size);
+    return 0;
+}
+
+/**
+ * Parses a text matrix: one row per line of whitespace-separated, optionally signed integers.
+ * Lines may be any length. Large regular files are parsed by several threads at once, anything
+ * else is streamed in MATRIX_PARSE_BLOCK blocks.
+ * If matrix is not NULL each value is stored into it as a rows x cols array, which the caller
+ * has zeroed; values beyond cols and lines beyond rows are skipped. If foundRows is not NULL it
+ * receives the number of lines up to the last line holding a value and foundCols the widest line.
+ * Returns 0 on success, -1 on a read error or malformed input, which is reported with its
+ * line and column.
+ */
+static inline int parseMatrixText(FILE *file, int *matrix, int rows, int cols, int *foundRows, int *foundCols) {
+    TextParse parse;
+    memset(&parse, 0, sizeof(parse));
+    parse.matrix = matrix;
+    parse.rows = rows;
+    parse.cols = cols;
+    parse.measuring = foundRows != NULL;
+
+    const int threads = matrixLoadThreads();
+    if ((threads < 2 || parseTextParallel(file, &parse, threads) == 1) && parseTextStream(file, &parse) == -1) {
+        return -1;
+    }
+
+    if (parse.problem != NULL) {
+        fprintf(stderr, "error: %s in matrix text at line %d, column %llu\n", parse.problem, parse.row + 1,
+                (unsigned long long)(parse.problemOffset - parse.lineOffset + 1));
+        return -1;
+    }
+
+    if (foundRows != NULL) {
+        *foundRows = parse.lastRow;
+        *foundCols = parse.widest;
+    }
+    return 0;
+}
+
+/**
+ * Measures a matrix file without storing it.
+ * For text, rows is the number of lines up to the last line holding a value and cols is the
+ * widest line; for binary files both come from the header.
+ * The file is rewound afterwards so it can be read with readMatrixFromFile.
+ * Returns 0 on success, -1 on a read error, malformed text, a damaged binary file or a file that
+ * cannot be rewound, such as a pipe.
+ */
+static inline int measureMatrixFile(FILE *file, int *rows, int *cols) {
+    MatrixFileHeader header;
+
+    *rows = 0;
+    *cols = 0;
+
+    switch (sniffMatrixFile(file, &header)) {
+    case 1:
+        *rows = header.rows;
+        *cols = header.cols;
+        return 0;
+    case -1:
+        return -1;
+    }
+
+    if (parseMatrixText(file, NULL, 0, 0, rows, cols) == -1) {
+        return -1;
+    }
+    if (fseek(file, 0, SEEK_SET) == -1) {
+        fprintf(stderr, "error: cannot rewind matrix file\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Copies a srcRows x srcCols row-major matrix into a rows x cols one, truncating or
+ * zero-padding each dimension.
+ */
+static inline void copyMatrixPadded(const int *src, int srcRows, int srcCols, int *matrix, int rows, int cols) {
+    const int copyRows = srcRows < rows ? srcRows : rows;
+    const int copyCols = srcCols < cols ? srcCols : cols;
+
+    memset(matrix, 0, (size_t)rows * cols * sizeof(int));
+    for (int i = 0; i < copyRows; i++) {
+        memcpy(matrix + (size_t)i * cols, src + (size_t)i * srcCols, copyCols * sizeof(int));
+    }
+}
+
+/**
+ * Reads a text or binary matrix into a rows x cols row-major array.
+ * Text lines may be any length. Missing values and missing rows are set to 0; values beyond
+ * cols and rows beyond rows are ignored.
+ * Returns 0 on success, -1 on a read error, malformed text or an unmappable binary file.
+ */
+static inline int readMatrixFromFile(FILE *file, int *matrix, int rows, int cols) {
+    MatrixFileHeader header;
+
+    if (sniffMatrixFile(file, &header) == 1) {
+        size_t mappingSize;
+        char *mapping = mapMatrixFile(file, &mappingSize);
+        if (mapping == NULL) {
+            fprintf(stderr, "error: cannot map binary matrix file\n");
+            memset(matrix, 0, (size_t)rows * cols * sizeof(int));
+            return -1;
+        }
+
+        copyMatrixPadded((const int *)(mapping + header.dataOffset), header.rows, header.cols, matrix, rows, cols);
+        munmap(mapping, mappingSize);
+        return 0;
+    }
+
+    memset(matrix, 0, (size_t)rows * cols * sizeof(int));
+    if (rows == 0) {
+        return 0;
+    }
+    return parseMatrixText(file, matrix, rows, cols, NULL, NULL);
+}
+
+/**
+ * Loads a whole matrix from an open file at its own size. Binary files are mapped and used
+ * in place without copying; text files are parsed into a cache-line-aligned heap buffer.
+ * The file can be closed afterwards. Returns 0 on success, -1 on failure.
+ * Release with closeMatrix.
+ */
+static inline int openMatrixFile(FILE *file, MatrixView *view) {
+    MatrixFileHeader header;
+    memset(view, 0, sizeof(*view));
+
+    switch (sniffMatrixFile(file, &header)) {
+    case 1: {
+        char *mapping = mapMatrixFile(file, &view->mappingSize);
+        if (mapping == NULL) {
+            return -1;
+        }
+        view->rows = header.rows;
+        view->cols = header.cols;
+        view->data = (const int *)(mapping + header.dataOffset);
+        view->mapping = mapping;
+        return 0;
+    }
+    case 0: {
+        int *matrix;
+        if (measureMatrixFile(file, &view->rows, &view->cols) == -1 ||
+            (matrix = allocMatrix(view->rows, view->cols)) == NULL) {
+            return -1;
+        }
+        if (readMatrixFromFile(file, matrix, view->rows, view->cols) == -1) {
+            free(matrix);
+            return -1;
+        }
+        view->data = matrix;
+        return 0;
+    }
+    }
+    return -1;
+}
+
+/**
+ * Opens path and loads it with openMatrixFile. Returns 0 on success, -1 on failure.
+ */
+static inline int openMatrix(const char *path, MatrixView *view) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        memset(view, 0, sizeof(*view));
+        return -1;
+    }
+
+    int status = openMatrixFile(file, view);
+    fclose(file);
+    return status;
+}
+
+/**
+ * Releases a matrix loaded by openMatrix.
+ */
+static inline void closeMatrix(MatrixView *view) {
+    if (view->mapping != NULL) {
+        munmap(view->mapping, view->mappingSize);
+    } else {
+        free((void *)view->data);
+    }
+    memset(view, 0, sizeof(*view));
+}
+
+/**
+ * Writes a rows x cols matrix in the binary format.
+ * Returns 0 on success, -1 on a write error.
+ */
+static inline int writeMatrixBinary(FILE *file, const int *matrix, int rows, int cols) {
+    MatrixFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.version = MATRIX_FILE_VERSION;
+    header.elementType = MATRIX_ELEMENT_INT32;
+    header.rows = rows;
+    header.cols = cols;
+    header.alignment = CACHE_LINE_SIZE;
+    header.dataOffset = sizeof(header);
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        return -1;
+    }
+    size_t count = (size_t)rows * cols;
+    return fwrite(matrix, sizeof(int), count, file) == count ? 0 : -1;
+}
+
+/**
+ * Writes a rows x cols matrix as text, one row per line with space-separated values.
+ * Returns 0 on success, -1 on a write error.
+ */
+static inline int writeMatrixText(FILE *file, const int *matrix, int rows, int cols) {
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            if (fprintf(file, j == 0 ? "%d" : " %d", matrix[(size_t)i * cols + j]) < 0) {
+                return -1;
+            }
+        }
+        if (fputc('\n', file) == EOF) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reads exactly count bytes from fd, retrying on short reads.
+ * Returns 0 on success, -1 on error or if the other end closed early.
+ */
+static inline int readFully(int fd, void *buf, size_t count) {
+    char *p = buf;
+    while (count > 0) {
+        ssize_t n = read(fd, p, count);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        count -= n;
+    }
+    return 0;
+}
+
+/**
+ * Writes exactly count bytes to fd, retrying on short writes.
+ * Returns 0 on success, -1 on error.
+ */
+static inline int writeFully(int fd, const void *buf, size_t count) {
+    const char *p = buf;
+    while (count > 0) {
+        ssize_t n = write(fd, p, count);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        count -= n;
+    }
+    return 0;
+}
+
+#endif
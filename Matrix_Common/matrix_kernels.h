@@ -0,0 +1,428 @@
+/**
+* Description: Shared integer matrix multiplication kernel used by every multiplier in this repository.
+* W is packed once into column panels, the loops are tiled so the working set of each level fits in
+* L1/L2/L3, and a register-blocked micro-kernel computes an MR x NR tile of the result at a time.
+* The micro-kernel and the element-wise add have scalar, SSE4.1, AVX2 and AVX-512 versions; the best
+* one the CPU supports is picked at startup. Set MATRIX_KERNEL=scalar|sse4.1|avx2|avx512 to force one.
+* A W that is mostly zero is kept in CSR form instead of panels and multiplied with the sparse kernel.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef MATRIX_KERNELS_H
+#define MATRIX_KERNELS_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "matrix_io.h"
+#include "matrix_sparse.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MATRIX_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// Register block: the micro-kernel keeps an MR x NR tile of the result in registers
+#define GEMM_MR 4
+#define GEMM_NR 8
+
+// Cache blocks: a KC x NR sliver of W stays in L1, an MC x KC block of A in L2,
+// and a KC x NC block of W in L3
+#define GEMM_KC 256
+#define GEMM_MC 64
+#define GEMM_NC 2048
+
+/**
+ * A right-hand matrix packed for gemmPacked.
+ * Columns are grouped into panels of GEMM_NR; each panel stores all rows contiguously,
+ * row by row, with the last panel zero-padded to GEMM_NR columns.
+ * A matrix sparse enough for useSparse is kept in CSR form instead, and data is NULL.
+ */
+typedef struct {
+    int rows;
+    int cols;
+    int panels;
+    int *data;
+    CsrMatrix *sparse; // CSR form of a sparse matrix, or NULL
+} PackedMatrix;
+
+/**
+ * Packs a srcRows x srcCols row-major matrix for gemmPacked as a rows x cols matrix,
+ * truncating or zero-padding each dimension. The source is only read, so it can be
+ * a binary matrix file mapped in place. Its density decides between panels and CSR form.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+static inline int packMatrixPadded(PackedMatrix *packed, const int *matrix, int srcRows, int srcCols,
+                                   int rows, int cols) {
+    packed->rows = rows;
+    packed->cols = cols;
+    packed->panels = (cols + GEMM_NR - 1) / GEMM_NR;
+    packed->data = NULL;
+    packed->sparse = NULL;
+
+    const int copyRows = srcRows < rows ? srcRows : rows;
+    const int copyCols = srcCols < cols ? srcCols : cols;
+
+    if (useSparse(countNonzeros(matrix, copyRows, copyCols, srcCols), rows, cols)) {
+        packed->sparse = malloc(sizeof(CsrMatrix));
+        if (packed->sparse == NULL || csrFromDense(packed->sparse, matrix, srcRows, srcCols, rows, cols) == -1) {
+            free(packed->sparse);
+            packed->sparse = NULL;
+            return -1;
+        }
+        return 0;
+    }
+
+    packed->data = allocMatrix(packed->panels * GEMM_NR, rows);
+    if (packed->data == NULL) {
+        return -1;
+    }
+
+    for (int panel = 0; panel < packed->panels; panel++) {
+        int *dest = packed->data + (size_t)panel * rows * GEMM_NR;
+        const int firstCol = panel * GEMM_NR;
+        const int width = copyCols - firstCol < GEMM_NR ? copyCols - firstCol : GEMM_NR;
+
+        for (int k = 0; k < copyRows && width > 0; k++) {
+            memcpy(dest + (size_t)k * GEMM_NR, matrix + (size_t)k * srcCols + firstCol, width * sizeof(int));
+        }
+    }
+    return 0;
+}
+
+/**
+ * Packs a rows x cols row-major matrix for gemmPacked.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+static inline int packMatrix(PackedMatrix *packed, const int *matrix, int rows, int cols) {
+    return packMatrixPadded(packed, matrix, rows, cols, rows, cols);
+}
+
+/**
+ * Releases the buffers held by a packed matrix.
+ */
+static inline void freePackedMatrix(PackedMatrix *packed) {
+    free(packed->data);
+    packed->data = NULL;
+    if (packed->sparse != NULL) {
+        freeCsrMatrix(packed->sparse);
+        free(packed->sparse);
+        packed->sparse = NULL;
+    }
+}
+
+/**
+ * Packs an mc x kc block of A into slivers of GEMM_MR rows, each stored column by column,
+ * zero-padding the last sliver.
+ */
+static inline void packBlockA(const int *A, int lda, int mc, int kc, int *dest) {
+    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+        const int height = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+
+        for (int p = 0; p < kc; p++) {
+            for (int i = 0; i < GEMM_MR; i++) {
+                dest[i] = i < height ? A[(size_t)(ir + i) * lda + p] : 0;
+            }
+            dest += GEMM_MR;
+        }
+    }
+}
+
+/**
+ * Tile kernels: multiply a packed GEMM_MR x kc sliver of A by a packed kc x GEMM_NR sliver of W
+ * into a GEMM_MR x GEMM_NR accumulator.
+ */
+typedef void (*TileKernel)(int kc, const int *a, const int *b, int acc[GEMM_MR][GEMM_NR]);
+
+/**
+ * Add kernels: out[i] = x[i] + y[i] for n values. out may alias x or y.
+ */
+typedef void (*AddKernel)(const int *x, const int *y, int *out, size_t n);
+
+static inline void tileScalar(int kc, const int *a, const int *b, int acc[GEMM_MR][GEMM_NR]) {
+    memset(acc, 0, sizeof(int) * GEMM_MR * GEMM_NR);
+
+    for (int p = 0; p < kc; p++) {
+        for (int i = 0; i < GEMM_MR; i++) {
+            const int aValue = a[i];
+            for (int j = 0; j < GEMM_NR; j++) {
+                acc[i][j] += aValue * b[j];
+            }
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+}
+
+static inline void addScalar(const int *x, const int *y, int *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = x[i] + y[i];
+    }
+}
+
+#ifdef MATRIX_KERNELS_X86
+
+__attribute__((target("sse4.1")))
+static void tileSse41(int kc, const int *a, const int *b, int acc[GEMM_MR][GEMM_NR]) {
+    __m128i sum[GEMM_MR][2];
+    for (int i = 0; i < GEMM_MR; i++) {
+        sum[i][0] = _mm_setzero_si128();
+        sum[i][1] = _mm_setzero_si128();
+    }
+
+    for (int p = 0; p < kc; p++) {
+        const __m128i b0 = _mm_loadu_si128((const __m128i *)b);
+        const __m128i b1 = _mm_loadu_si128((const __m128i *)(b + 4));
+        for (int i = 0; i < GEMM_MR; i++) {
+            const __m128i aValue = _mm_set1_epi32(a[i]);
+            sum[i][0] = _mm_add_epi32(sum[i][0], _mm_mullo_epi32(aValue, b0));
+            sum[i][1] = _mm_add_epi32(sum[i][1], _mm_mullo_epi32(aValue, b1));
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    for (int i = 0; i < GEMM_MR; i++) {
+        _mm_storeu_si128((__m128i *)acc[i], sum[i][0]);
+        _mm_storeu_si128((__m128i *)(acc[i] + 4), sum[i][1]);
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void addSse41(const int *x, const int *y, int *out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i sum = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(x + i)),
+                                          _mm_loadu_si128((const __m128i *)(y + i)));
+        _mm_storeu_si128((__m128i *)(out + i), sum);
+    }
+    addScalar(x + i, y + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void tileAvx2(int kc, const int *a, const int *b, int acc[GEMM_MR][GEMM_NR]) {
+    __m256i sum[GEMM_MR];
+    for (int i = 0; i < GEMM_MR; i++) {
+        sum[i] = _mm256_setzero_si256();
+    }
+
+    for (int p = 0; p < kc; p++) {
+        const __m256i bRow = _mm256_loadu_si256((const __m256i *)b);
+        for (int i = 0; i < GEMM_MR; i++) {
+            sum[i] = _mm256_add_epi32(sum[i], _mm256_mullo_epi32(_mm256_set1_epi32(a[i]), bRow));
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    for (int i = 0; i < GEMM_MR; i++) {
+        _mm256_storeu_si256((__m256i *)acc[i], sum[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+static void addAvx2(const int *x, const int *y, int *out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(x + i)),
+                                             _mm256_loadu_si256((const __m256i *)(y + i)));
+        _mm256_storeu_si256((__m256i *)(out + i), sum);
+    }
+    addScalar(x + i, y + i, out + i, n - i);
+}
+
+// A 512-bit register holds two GEMM_NR rows, so each accumulator covers two rows of the tile
+__attribute__((target("avx512f")))
+static void tileAvx512(int kc, const int *a, const int *b, int acc[GEMM_MR][GEMM_NR]) {
+    const __m512i rows01 = _mm512_set_epi32(1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m512i rows23 = _mm512_set_epi32(3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2);
+    __m512i sum01 = _mm512_setzero_si512();
+    __m512i sum23 = _mm512_setzero_si512();
+
+    for (int p = 0; p < kc; p++) {
+        const __m512i bRows = _mm512_broadcast_i64x4(_mm256_loadu_si256((const __m256i *)b));
+        const __m512i aValues = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i *)a));
+        sum01 = _mm512_add_epi32(sum01, _mm512_mullo_epi32(_mm512_permutexvar_epi32(rows01, aValues), bRows));
+        sum23 = _mm512_add_epi32(sum23, _mm512_mullo_epi32(_mm512_permutexvar_epi32(rows23, aValues), bRows));
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    _mm512_storeu_si512(acc[0], sum01);
+    _mm512_storeu_si512(acc[2], sum23);
+}
+
+__attribute__((target("avx512f")))
+static void addAvx512(const int *x, const int *y, int *out, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512i sum = _mm512_add_epi32(_mm512_loadu_si512(x + i), _mm512_loadu_si512(y + i));
+        _mm512_storeu_si512(out + i, sum);
+    }
+    addScalar(x + i, y + i, out + i, n - i);
+}
+
+#endif
+
+/**
+ * The kernels in use by this process, chosen by selectMatrixKernels before main runs.
+ */
+static struct {
+    const char *name;
+    int level; // 0 scalar, 1 SSE4.1, 2 AVX2, 3 AVX-512
+    TileKernel tile;
+    AddKernel add;
+} matrixKernels = {"scalar", 0, tileScalar, addScalar};
+
+/**
+ * Picks the widest kernels the CPU supports, unless MATRIX_KERNEL asks for a narrower
+ * (supported) set.
+ */
+__attribute__((constructor))
+static void selectMatrixKernels(void) {
+#ifdef MATRIX_KERNELS_X86
+    const char *requested = getenv("MATRIX_KERNEL");
+    int allowed = 3; // 0 scalar, 1 SSE4.1, 2 AVX2, 3 AVX-512
+
+    if (requested != NULL) {
+        if (strcmp(requested, "scalar") == 0) allowed = 0;
+        else if (strcmp(requested, "sse4.1") == 0) allowed = 1;
+        else if (strcmp(requested, "avx2") == 0) allowed = 2;
+    }
+
+    __builtin_cpu_init();
+    if (allowed >= 3 && __builtin_cpu_supports("avx512f")) {
+        matrixKernels.name = "avx512";
+        matrixKernels.level = 3;
+        matrixKernels.tile = tileAvx512;
+        matrixKernels.add = addAvx512;
+    } else if (allowed >= 2 && __builtin_cpu_supports("avx2")) {
+        matrixKernels.name = "avx2";
+        matrixKernels.level = 2;
+        matrixKernels.tile = tileAvx2;
+        matrixKernels.add = addAvx2;
+    } else if (allowed >= 1 && __builtin_cpu_supports("sse4.1")) {
+        matrixKernels.name = "sse4.1";
+        matrixKernels.level = 1;
+        matrixKernels.tile = tileSse41;
+        matrixKernels.add = addSse41;
+    }
+#endif
+}
+
+/**
+ * Returns the name of the kernel set in use: scalar, sse4.1, avx2 or avx512.
+ */
+static inline const char *matrixKernelName(void) {
+    return matrixKernels.name;
+}
+
+/**
+ * Element-wise addition of two int arrays of n values: out = x + y. out may alias x or y.
+ */
+static inline void addMatrices(const int *x, const int *y, int *out, size_t n) {
+    matrixKernels.add(x, y, out, n);
+}
+
+/**
+ * Micro-kernel: multiplies a packed GEMM_MR x kc sliver of A by a packed kc x GEMM_NR sliver of W
+ * and stores (or, when accumulate is set, adds) the top-left mr x nr corner of the tile into C.
+ */
+static inline void gemmMicroKernel(int kc, const int *a, const int *b, int *C, int ldc,
+                                   int mr, int nr, int accumulate) {
+    int acc[GEMM_MR][GEMM_NR];
+    matrixKernels.tile(kc, a, b, acc);
+
+    for (int i = 0; i < mr; i++) {
+        int *row = C + (size_t)i * ldc;
+        for (int j = 0; j < nr; j++) {
+            row[j] = accumulate ? row[j] + acc[i][j] : acc[i][j];
+        }
+    }
+}
+
+/**
+ * Computes C = A * W for m rows of A.
+ * A points at the first row to multiply and has row stride lda; C points at the matching
+ * output row and has row stride ldc. W must have been packed with packMatrix, and A must
+ * have W->rows columns. Returns 0 on success, -1 if memory could not be allocated.
+ */
+static inline int gemmPacked(const int *A, int lda, const PackedMatrix *W, int *C, int ldc, int m) {
+    const int k = W->rows;
+    const int n = W->cols;
+
+    if (W->sparse != NULL) {
+        spmmCsr(A, lda, W->sparse, C, ldc, m);
+        return 0;
+    }
+
+    if (m <= 0) {
+        return 0;
+    }
+    if (k == 0) {
+        for (int i = 0; i < m; i++) {
+            memset(C + (size_t)i * ldc, 0, n * sizeof(int));
+        }
+        return 0;
+    }
+
+    // Only as large as the biggest block this call packs, rounded up to whole slivers. packBlockA
+    // writes every value the micro-kernel reads, so the buffer needs no zeroing; a single row
+    // costs a small allocation instead of a full GEMM_MC x GEMM_KC one.
+    const int maxMc = m < GEMM_MC ? m : GEMM_MC;
+    const int maxKc = k < GEMM_KC ? k : GEMM_KC;
+    const size_t slivers = ((size_t)maxMc + GEMM_MR - 1) / GEMM_MR;
+    int *blockA = aligned_alloc(CACHE_LINE_SIZE, cacheLineRound(slivers * GEMM_MR * maxKc * sizeof(int)));
+    if (blockA == NULL) {
+        return -1;
+    }
+
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+        const int nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+
+        for (int pc = 0; pc < k; pc += GEMM_KC) {
+            const int kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+
+            for (int ic = 0; ic < m; ic += GEMM_MC) {
+                const int mc = m - ic < GEMM_MC ? m - ic : GEMM_MC;
+                packBlockA(A + (size_t)ic * lda + pc, lda, mc, kc, blockA);
+
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    const int nr = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+                    const int panel = (jc + jr) / GEMM_NR;
+                    const int *b = W->data + ((size_t)panel * k + pc) * GEMM_NR;
+
+                    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+                        const int mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+                        gemmMicroKernel(kc, blockA + (size_t)ir * kc, b,
+                                        C + (size_t)(ic + ir) * ldc + jc + jr, ldc, mr, nr, pc > 0);
+                    }
+                }
+            }
+        }
+    }
+
+    free(blockA);
+    return 0;
+}
+
+/**
+ * Convenience wrapper: C (m x n) = A (m x k) * W (k x n), all row-major and densely stored.
+ * Packs W on every call, so callers that multiply many times by the same W should
+ * use packMatrix once and call gemmPacked instead.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+static inline int gemm(const int *A, const int *W, int *C, int m, int k, int n) {
+    PackedMatrix packed;
+    if (packMatrix(&packed, W, k, n) == -1) {
+        return -1;
+    }
+
+    int status = gemmPacked(A, k, &packed, C, n, m);
+    freePackedMatrix(&packed);
+    return status;
+}
+
+#endif
@@ -0,0 +1,186 @@
+/**
+* Description: Compressed sparse row (CSR) storage for mostly-zero matrices, with the sparse
+* vector-matrix (SpMV) and matrix-matrix (SpMM) products used when W is sparse.
+* A CSR matrix keeps only its nonzero values, row by row, with the column of each one. Multiplying
+* a row x of A by it adds x[k] times row k of W into the result for every nonzero x[k], so the work
+* is proportional to the nonzeros of both operands instead of the full dense product.
+* useSparse measures a matrix's density and decides which form to use; set MATRIX_SPARSE=always or
+* never to force one, for example when comparing timings.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef MATRIX_SPARSE_H
+#define MATRIX_SPARSE_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "matrix_io.h"
+
+// Environment variable forcing the sparse or the dense form
+#define SPARSE_ENV "MATRIX_SPARSE"
+
+// A matrix is stored sparse when at most 1 in SPARSE_DENSITY_DIVISOR of its values is nonzero
+#define SPARSE_DENSITY_DIVISOR 16
+
+/**
+ * A matrix in compressed sparse row form. The nonzeros of row i are values[rowStart[i]] up to
+ * values[rowStart[i + 1] - 1], in column order, and columns holds the column of each.
+ */
+typedef struct {
+    int rows;
+    int cols;
+    size_t nonzeros;
+    size_t *rowStart; // rows + 1 entries
+    int *columns;
+    int *values;
+} CsrMatrix;
+
+/**
+ * Returns the nonzero values of a rows x cols block of a row-major matrix whose rows are stride apart.
+ */
+static inline size_t countNonzeros(const int *matrix, int rows, int cols, int stride) {
+    size_t count = 0;
+    for (int i = 0; i < rows; i++) {
+        const int *row = matrix + (size_t)i * stride;
+        for (int j = 0; j < cols; j++) {
+            count += row[j] != 0;
+        }
+    }
+    return count;
+}
+
+/**
+ * Returns 1 if a rows x cols matrix with nonzeros nonzero values should be stored sparse.
+ * MATRIX_SPARSE=always or never overrides the density test.
+ */
+static inline int useSparse(size_t nonzeros, int rows, int cols) {
+    const char *mode = getenv(SPARSE_ENV);
+    if (mode != NULL && strcmp(mode, "always") == 0) {
+        return 1;
+    }
+    if (mode != NULL && strcmp(mode, "never") == 0) {
+        return 0;
+    }
+    return nonzeros * SPARSE_DENSITY_DIVISOR <= (size_t)rows * cols;
+}
+
+/**
+ * Builds the CSR form of a srcRows x srcCols row-major matrix as a rows x cols matrix, truncating
+ * or zero-padding each dimension like packMatrixPadded.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+static inline int csrFromDense(CsrMatrix *sparse, const int *matrix, int srcRows, int srcCols, int rows, int cols) {
+    const int copyRows = srcRows < rows ? srcRows : rows;
+    const int copyCols = srcCols < cols ? srcCols : cols;
+    const size_t nonzeros = countNonzeros(matrix, copyRows, copyCols, srcCols);
+
+    sparse->rows = rows;
+    sparse->cols = cols;
+    sparse->nonzeros = nonzeros;
+    sparse->rowStart = malloc(((size_t)rows + 1) * sizeof(size_t));
+    sparse->columns = malloc((nonzeros > 0 ? nonzeros : 1) * sizeof(int));
+    sparse->values = malloc((nonzeros > 0 ? nonzeros : 1) * sizeof(int));
+    if (sparse->rowStart == NULL || sparse->columns == NULL || sparse->values == NULL) {
+        free(sparse->rowStart);
+        free(sparse->columns);
+        free(sparse->values);
+        return -1;
+    }
+
+    size_t next = 0;
+    for (int i = 0; i < rows; i++) {
+        sparse->rowStart[i] = next;
+        if (i >= copyRows) {
+            continue;
+        }
+        const int *row = matrix + (size_t)i * srcCols;
+        for (int j = 0; j < copyCols; j++) {
+            if (row[j] != 0) {
+                sparse->columns[next] = j;
+                sparse->values[next] = row[j];
+                next++;
+            }
+        }
+    }
+    sparse->rowStart[rows] = next;
+    return 0;
+}
+
+/**
+ * Releases the arrays held by a CSR matrix.
+ */
+static inline void freeCsrMatrix(CsrMatrix *sparse) {
+    free(sparse->rowStart);
+    free(sparse->columns);
+    free(sparse->values);
+    sparse->rowStart = NULL;
+    sparse->columns = NULL;
+    sparse->values = NULL;
+}
+
+/**
+ * SpMV: y = x * W for a row vector x of W->rows values. y holds W->cols values.
+ * Zero entries of x are skipped, so a sparse x costs less as well. Sums are taken in
+ * unsigned arithmetic, so they wrap around on overflow.
+ */
+static inline void spmvCsr(const int *x, const CsrMatrix *W, int *y) {
+    memset(y, 0, (size_t)W->cols * sizeof(int));
+    unsigned *out = (unsigned *)y;
+    for (int k = 0; k < W->rows; k++) {
+        const unsigned scale = (unsigned)x[k];
+        if (scale == 0) {
+            continue;
+        }
+        for (size_t p = W->rowStart[k]; p < W->rowStart[k + 1]; p++) {
+            out[W->columns[p]] += scale * (unsigned)W->values[p];
+        }
+    }
+}
+
+/**
+ * SpMM: C = A * W for m rows of A, which are lda apart and have W->rows values each.
+ * The rows of C are ldc apart and get W->cols values each. Four rows are computed together,
+ * so each row of W is read once for all of them.
+ */
+static inline void spmmCsr(const int *A, int lda, const CsrMatrix *W, int *C, int ldc, int m) {
+    const size_t rowBytes = (size_t)W->cols * sizeof(int);
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+        unsigned *c0 = (unsigned *)(C + (size_t)i * ldc);
+        unsigned *c1 = c0 + ldc;
+        unsigned *c2 = c1 + ldc;
+        unsigned *c3 = c2 + ldc;
+        memset(c0, 0, rowBytes);
+        memset(c1, 0, rowBytes);
+        memset(c2, 0, rowBytes);
+        memset(c3, 0, rowBytes);
+
+        const int *a = A + (size_t)i * lda;
+        for (int k = 0; k < W->rows; k++) {
+            const unsigned s0 = (unsigned)a[k];
+            const unsigned s1 = (unsigned)a[k + lda];
+            const unsigned s2 = (unsigned)a[k + 2 * (size_t)lda];
+            const unsigned s3 = (unsigned)a[k + 3 * (size_t)lda];
+            if ((s0 | s1 | s2 | s3) == 0) {
+                continue;
+            }
+            for (size_t p = W->rowStart[k]; p < W->rowStart[k + 1]; p++) {
+                const int column = W->columns[p];
+                const unsigned value = (unsigned)W->values[p];
+                c0[column] += s0 * value;
+                c1[column] += s1 * value;
+                c2[column] += s2 * value;
+                c3[column] += s3 * value;
+            }
+        }
+    }
+
+    for (; i < m; i++) {
+        spmvCsr(A + (size_t)i * lda, W, C + (size_t)i * ldc);
+    }
+}
+
+#endif
@@ -0,0 +1,227 @@
+/**
+* Description: Parse-once store of matrices in shared memory for a coordinator and its children.
+* The coordinator creates a directory under /dev/shm for the run and names it in MATRIX_STORE_DIR,
+* which its children inherit. It parses each input once and publishes it there in the binary matrix
+* format. A child that opens the same file then maps the stored copy read-only, so every child shares
+* one copy in the page cache and none of them parses the text again.
+* Entries are keyed by the file's device, inode, size and modification time, so a file that changes
+* gets a new entry, and a child always reads what the file holds when it opens it.
+* Files smaller than MATRIX_STORE_MIN_BYTES are parsed directly, which is faster than mapping them.
+* The process that creates the store also removes it when it exits, is interrupted with Ctrl-C or
+* is terminated; forked children that exit leave it alone.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef MATRIX_STORE_H
+#define MATRIX_STORE_H
+
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "matrix_io.h"
+
+// Environment variable naming the store directory a child inherits
+#define MATRIX_STORE_ENV "MATRIX_STORE_DIR"
+
+// Where run directories are created
+#define MATRIX_STORE_ROOT "/dev/shm"
+
+// Files below this size are parsed by each reader instead of being stored
+#define MATRIX_STORE_MIN_BYTES (64 * 1024)
+
+// The store this process created, and the process that owns it; forked children inherit both
+static char matrixStoreDir[PATH_MAX];
+static volatile pid_t matrixStoreOwner;
+
+// Stores this process has written, numbering its temporary files
+static unsigned matrixStoreWrites;
+
+// One directory entry as getdents64 returns it
+struct matrixStoreEntry {
+    unsigned long long inode;
+    long long offset;
+    unsigned short length;
+    unsigned char type;
+    char name[];
+};
+
+/**
+ * Deletes a store directory and everything in it. Uses only async-signal-safe calls, so it can
+ * run in a signal handler. Children that still map a stored matrix keep their mapping.
+ */
+static inline void deleteMatrixStoreDir(const char *dir) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd != -1) {
+        char buffer[4096] __attribute__((aligned(8)));
+        long length;
+        while ((length = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0) {
+            for (long offset = 0; offset < length;) {
+                const struct matrixStoreEntry *entry = (const struct matrixStoreEntry *)(buffer + offset);
+                if (strcmp(entry->name, ".") != 0 && strcmp(entry->name, "..") != 0) {
+                    unlinkat(fd, entry->name, 0);
+                }
+                offset += entry->length;
+            }
+        }
+        close(fd);
+    }
+    rmdir(dir);
+}
+
+/**
+ * Deletes the store directory and everything in it, if this process created it. Called by the
+ * creator after its children are done, and by the exit and signal handlers; in a forked child,
+ * or once the store is gone, it does nothing.
+ */
+static inline void removeMatrixStore(void) {
+    if (matrixStoreDir[0] == '\0' || getpid() != matrixStoreOwner) {
+        return;
+    }
+    deleteMatrixStoreDir(matrixStoreDir);
+    matrixStoreDir[0] = '\0';
+    unsetenv(MATRIX_STORE_ENV);
+}
+
+/**
+ * Removes the store when the creator is interrupted or terminated, then dies of the same signal.
+ */
+static inline void removeMatrixStoreOnSignal(int signalNumber) {
+    if (matrixStoreDir[0] != '\0' && getpid() == matrixStoreOwner) {
+        deleteMatrixStoreDir(matrixStoreDir);
+    }
+    signal(signalNumber, SIG_DFL);
+    raise(signalNumber);
+}
+
+/**
+ * Creates this run's store directory and names it in MATRIX_STORE_DIR, so children forked or
+ * executed afterwards use it. The store is removed when this process exits, even through exit(),
+ * and on SIGINT or SIGTERM unless the program already handles or ignores them.
+ * Returns 0, or -1 if no directory can be created, in which case every reader parses its files itself.
+ */
+static inline int createMatrixStore(void) {
+    char dir[] = MATRIX_STORE_ROOT "/matrix-store.XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        return -1;
+    }
+    if (setenv(MATRIX_STORE_ENV, dir, 1) == -1) {
+        rmdir(dir);
+        return -1;
+    }
+    strcpy(matrixStoreDir, dir);
+    matrixStoreOwner = getpid();
+
+    atexit(removeMatrixStore);
+    const int signals[] = {SIGINT, SIGTERM};
+    for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) {
+        struct sigaction current;
+        if (sigaction(signals[i], NULL, &current) == 0 && current.sa_handler == SIG_DFL) {
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = removeMatrixStoreOnSignal;
+            sigemptyset(&action.sa_mask);
+            sigaction(signals[i], &action, NULL);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Writes the store path of the file at path into stored, which holds PATH_MAX bytes. Returns 1 if
+ * the file belongs in the store, 0 if there is no store or the file is too small to store, and -1
+ * if the file cannot be examined.
+ */
+static inline int matrixStorePath(const char *path, char *stored) {
+    struct stat info;
+    if (stat(path, &info) == -1) {
+        return -1;
+    }
+
+    const char *dir = getenv(MATRIX_STORE_ENV);
+    if (dir == NULL || *dir == '\0' || info.st_size < MATRIX_STORE_MIN_BYTES) {
+        return 0;
+    }
+
+    int length = snprintf(stored, PATH_MAX, "%s/%llx-%llx-%llx-%lld.%09ld.mtxb", dir, (unsigned long long)info.st_dev,
+                          (unsigned long long)info.st_ino, (unsigned long long)info.st_size,
+                          (long long)info.st_mtim.tv_sec, info.st_mtim.tv_nsec);
+    return length < PATH_MAX;
+}
+
+/**
+ * Parses the matrix at path and stores it, unless it is already stored, too small or already a
+ * binary file, which readers map in place anyway. The copy is written under a temporary name and
+ * renamed, so readers never see half a file. Returns 0, or -1 if the file cannot be read or stored.
+ */
+static inline int publishMatrix(const char *path) {
+    char stored[PATH_MAX];
+    int inStore = matrixStorePath(path, stored);
+    if (inStore != 1) {
+        return inStore;
+    }
+    if (access(stored, F_OK) == 0) {
+        return 0;
+    }
+
+    MatrixView view;
+    if (openMatrix(path, &view) == -1) {
+        return -1;
+    }
+    if (view.mapping != NULL) {
+        closeMatrix(&view);
+        return 0;
+    }
+
+    char temporary[PATH_MAX];
+    snprintf(temporary, sizeof(temporary), "%s/.tmp.%d.%u", getenv(MATRIX_STORE_ENV), (int)getpid(),
+             matrixStoreWrites++);
+    FILE *file = fopen(temporary, "w");
+    int status = -1;
+    if (file != NULL) {
+        status = writeMatrixBinary(file, view.data, view.rows, view.cols);
+        if (fclose(file) != 0 || status == -1 || rename(temporary, stored) == -1) {
+            unlink(temporary);
+            status = -1;
+        }
+    }
+    closeMatrix(&view);
+    return status;
+}
+
+/**
+ * Loads the matrix at path like openMatrix, mapping its stored copy when there is one.
+ * Returns 0 on success, -1 on failure. Release with closeMatrix.
+ */
+static inline int openStoredMatrix(const char *path, MatrixView *view) {
+    char stored[PATH_MAX];
+    if (matrixStorePath(path, stored) == 1 && openMatrix(stored, view) == 0) {
+        return 0;
+    }
+    return openMatrix(path, view);
+}
+
+/**
+ * Reads the matrix at path into a rows x cols row-major array like readMatrixFromFile, from its
+ * stored copy when there is one. Returns 0 on success, -1 on failure.
+ */
+static inline int readStoredMatrix(const char *path, int *matrix, int rows, int cols) {
+    MatrixView view;
+    if (openStoredMatrix(path, &view) == -1) {
+        memset(matrix, 0, (size_t)rows * cols * sizeof(int));
+        return -1;
+    }
+    copyMatrixPadded(view.data, view.rows, view.cols, matrix, rows, cols);
+    closeMatrix(&view);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,369 @@
+/**
+* Description: Content-addressed cache of multiplication results, keyed by hashes of the bytes of the A and W files.
+* Results live in memory up to a size limit, evicting the least recently used, and can also be kept
+* on disk in a directory shared by every process, so a result computed by one child or run serves the next.
+* MATRIX_CACHE_MB sets the memory limit in MiB (default 64, 0 turns the cache off) and MATRIX_CACHE_DIR
+* names the disk directory (unset keeps results in memory only).
+* The hash is a fast 128-bit non-cryptographic hash, which tells apart accidental differences, not crafted ones.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "matrix_io.h"
+
+// Environment variables holding the memory limit in MiB and the disk directory
+#define CACHE_LIMIT_ENV "MATRIX_CACHE_MB"
+#define CACHE_DIR_ENV "MATRIX_CACHE_DIR"
+
+// Memory limit when MATRIX_CACHE_MB is not set
+#define CACHE_DEFAULT_MB 64
+
+// Buckets in a new table; the table doubles when it holds more entries than buckets
+#define CACHE_INITIAL_BUCKETS 1024
+
+// Hash of a file's content
+typedef struct {
+    uint64_t lo;
+    uint64_t hi;
+} ContentHash;
+
+// One cached result. values holds rows x cols ints.
+typedef struct CacheEntry {
+    ContentHash a;
+    ContentHash w;
+    struct CacheEntry *chain; // Next entry in the same bucket
+    struct CacheEntry *newer; // LRU neighbours
+    struct CacheEntry *older;
+    size_t bytes;             // Memory charged to the entry
+    int rows;
+    int cols;
+    int values[];
+} CacheEntry;
+
+typedef struct {
+    CacheEntry **buckets;
+    size_t bucketCount;
+    size_t entryCount;
+    CacheEntry *newest;
+    CacheEntry *oldest;
+    size_t bytes;             // Memory held by the entries
+    size_t limit;             // 0 when the cache is off
+    char dir[PATH_MAX - 128]; // Disk directory, empty when results stay in memory; leaves room for file names
+    unsigned storeCount;      // Results written to disk, for unique temporary names
+    uint64_t hits;
+    uint64_t misses;
+} ResultCache;
+
+/**
+ * Mixes the bits of x so every input bit affects every output bit.
+ */
+static inline uint64_t hashMix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/**
+ * Hashes length bytes of data into 128 bits with two independent lanes over 8-byte words.
+ */
+static inline ContentHash hashContent(const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    uint64_t lo = 0x9e3779b97f4a7c15ULL ^ length;
+    uint64_t hi = 0xc2b2ae3d27d4eb4fULL + length;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        lo = ((lo ^ word) << 31 | (lo ^ word) >> 33) * 0x87c37b91114253d5ULL;
+        hi = ((hi + word) << 29 | (hi + word) >> 35) * 0x4cf5ad432745937fULL;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, length - i);
+    lo = hashMix(lo ^ tail);
+    hi = hashMix(hi + tail + lo);
+    return (ContentHash){lo, hi};
+}
+
+/**
+ * Hashes the whole content of an open file, which is mapped rather than read. Returns 0, or -1 if
+ * the file cannot be mapped.
+ */
+static inline int hashMatrixFile(FILE *file, ContentHash *hash) {
+    struct stat info;
+    if (fstat(fileno(file), &info) == -1) {
+        return -1;
+    }
+    if (info.st_size == 0) {
+        *hash = hashContent("", 0);
+        return 0;
+    }
+
+    size_t mappingSize;
+    void *mapping = mapMatrixFile(file, &mappingSize);
+    if (mapping == NULL) {
+        return -1;
+    }
+    *hash = hashContent(mapping, mappingSize);
+    munmap(mapping, mappingSize);
+    return 0;
+}
+
+/**
+ * Folds settings that change a result, such as the padded inner dimension, into a content hash.
+ */
+static inline ContentHash hashWithSetting(ContentHash hash, uint64_t setting) {
+    hash.lo = hashMix(hash.lo ^ setting);
+    hash.hi = hashMix(hash.hi + setting + hash.lo);
+    return hash;
+}
+
+/**
+ * Prepares a cache from MATRIX_CACHE_MB and MATRIX_CACHE_DIR. Returns 0, or -1 if the table cannot
+ * be allocated, in which case the cache stays off.
+ */
+static inline int resultCacheInit(ResultCache *cache) {
+    memset(cache, 0, sizeof(*cache));
+
+    const char *limit = getenv(CACHE_LIMIT_ENV);
+    long megabytes = (limit != NULL && *limit != '\0') ? atol(limit) : CACHE_DEFAULT_MB;
+    if (megabytes <= 0) {
+        return 0;
+    }
+
+    cache->buckets = calloc(CACHE_INITIAL_BUCKETS, sizeof(CacheEntry *));
+    if (cache->buckets == NULL) {
+        return -1;
+    }
+    cache->bucketCount = CACHE_INITIAL_BUCKETS;
+    cache->limit = (size_t)megabytes << 20;
+
+    const char *dir = getenv(CACHE_DIR_ENV);
+    if (dir != NULL && *dir != '\0' && strlen(dir) < sizeof(cache->dir)) {
+        strcpy(cache->dir, dir);
+    }
+    return 0;
+}
+
+/**
+ * Returns the bucket of the (a, w) pair.
+ */
+static inline CacheEntry **cacheBucket(const ResultCache *cache, ContentHash a, ContentHash w) {
+    return &cache->buckets[(a.lo ^ hashMix(w.lo)) & (cache->bucketCount - 1)];
+}
+
+/**
+ * Moves entry to the newest end of the LRU list, unlinking it first if it is already listed.
+ */
+static inline void cacheTouch(ResultCache *cache, CacheEntry *entry, int listed) {
+    if (listed) {
+        if (cache->newest == entry) {
+            return;
+        }
+        entry->newer->older = entry->older;
+        if (entry->older != NULL) {
+            entry->older->newer = entry->newer;
+        } else {
+            cache->oldest = entry->newer;
+        }
+    }
+
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest != NULL) {
+        cache->newest->newer = entry;
+    }
+    cache->newest = entry;
+    if (cache->oldest == NULL) {
+        cache->oldest = entry;
+    }
+}
+
+/**
+ * Removes and frees the least recently used entry.
+ */
+static inline void cacheEvictOldest(ResultCache *cache) {
+    CacheEntry *victim = cache->oldest;
+    CacheEntry **link = cacheBucket(cache, victim->a, victim->w);
+    while (*link != victim) {
+        link = &(*link)->chain;
+    }
+    *link = victim->chain;
+
+    cache->oldest = victim->newer;
+    if (cache->oldest != NULL) {
+        cache->oldest->older = NULL;
+    } else {
+        cache->newest = NULL;
+    }
+    cache->bytes -= victim->bytes;
+    cache->entryCount--;
+    free(victim);
+}
+
+/**
+ * Doubles the bucket array and rehashes every entry. Leaves the table as it is if memory runs out.
+ */
+static inline void cacheGrow(ResultCache *cache) {
+    size_t oldCount = cache->bucketCount;
+    CacheEntry **old = cache->buckets;
+    CacheEntry **grown = calloc(oldCount * 2, sizeof(CacheEntry *));
+    if (grown == NULL) {
+        return;
+    }
+
+    cache->buckets = grown;
+    cache->bucketCount = oldCount * 2;
+    for (size_t i = 0; i < oldCount; ++i) {
+        CacheEntry *entry = old[i];
+        while (entry != NULL) {
+            CacheEntry *next = entry->chain;
+            CacheEntry **bucket = cacheBucket(cache, entry->a, entry->w);
+            entry->chain = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(old);
+}
+
+/**
+ * Adds a copy of a rows x cols result to memory, evicting least recently used entries to stay within
+ * the limit. Returns the entry, or NULL if the cache is off, the result is larger than the limit or
+ * memory runs out.
+ */
+static inline CacheEntry *cacheInsert(ResultCache *cache, ContentHash a, ContentHash w, const int *values, int rows,
+                                      int cols) {
+    size_t bytes = sizeof(CacheEntry) + (size_t)rows * cols * sizeof(int);
+    if (cache->limit == 0 || bytes > cache->limit) {
+        return NULL;
+    }
+    while (cache->bytes + bytes > cache->limit) {
+        cacheEvictOldest(cache);
+    }
+
+    CacheEntry *entry = malloc(bytes);
+    if (entry == NULL) {
+        return NULL;
+    }
+    entry->a = a;
+    entry->w = w;
+    entry->bytes = bytes;
+    entry->rows = rows;
+    entry->cols = cols;
+    memcpy(entry->values, values, (size_t)rows * cols * sizeof(int));
+
+    if (cache->entryCount >= cache->bucketCount) {
+        cacheGrow(cache);
+    }
+    CacheEntry **bucket = cacheBucket(cache, a, w);
+    entry->chain = *bucket;
+    *bucket = entry;
+    cacheTouch(cache, entry, 0);
+    cache->bytes += bytes;
+    cache->entryCount++;
+    return entry;
+}
+
+/**
+ * Writes the disk path of the (a, w) pair into path, which holds PATH_MAX bytes.
+ */
+static inline void cachePath(const ResultCache *cache, ContentHash a, ContentHash w, char *path) {
+    snprintf(path, PATH_MAX, "%s/%016llx%016llx-%016llx%016llx.mtxb", cache->dir, (unsigned long long)a.hi,
+             (unsigned long long)a.lo, (unsigned long long)w.hi, (unsigned long long)w.lo);
+}
+
+/**
+ * Returns the cached result of A times W, looking in memory and then on disk, or NULL on a miss.
+ * The entry stays valid until the next resultCacheStore.
+ */
+static inline const CacheEntry *resultCacheLookup(ResultCache *cache, ContentHash a, ContentHash w) {
+    if (cache->limit == 0) {
+        return NULL;
+    }
+
+    for (CacheEntry *entry = *cacheBucket(cache, a, w); entry != NULL; entry = entry->chain) {
+        if (entry->a.lo == a.lo && entry->a.hi == a.hi && entry->w.lo == w.lo && entry->w.hi == w.hi) {
+            cacheTouch(cache, entry, 1);
+            cache->hits++;
+            return entry;
+        }
+    }
+
+    if (cache->dir[0] != '\0') {
+        char path[PATH_MAX];
+        MatrixView view;
+        cachePath(cache, a, w, path);
+        if (openMatrix(path, &view) == 0) {
+            CacheEntry *entry = cacheInsert(cache, a, w, view.data, view.rows, view.cols);
+            closeMatrix(&view);
+            if (entry != NULL) {
+                cache->hits++;
+                return entry;
+            }
+        }
+    }
+
+    cache->misses++;
+    return NULL;
+}
+
+/**
+ * Caches a rows x cols result of A times W in memory and, with a disk directory, on disk. The disk
+ * copy is written to a temporary name and renamed, so other processes never read half a file.
+ * The cache is best effort: a result that cannot be stored is simply recomputed next time.
+ */
+static inline void resultCacheStore(ResultCache *cache, ContentHash a, ContentHash w, const int *values, int rows,
+                                    int cols) {
+    if (cache->limit == 0) {
+        return;
+    }
+    cacheInsert(cache, a, w, values, rows, cols);
+
+    if (cache->dir[0] != '\0') {
+        char path[PATH_MAX];
+        char temporary[PATH_MAX];
+        cachePath(cache, a, w, path);
+        snprintf(temporary, sizeof(temporary), "%s/.tmp.%d.%u", cache->dir, (int)getpid(), cache->storeCount++);
+
+        FILE *file = fopen(temporary, "w");
+        if (file == NULL) {
+            return;
+        }
+        int written = writeMatrixBinary(file, values, rows, cols) == 0;
+        if (fclose(file) != 0 || !written || rename(temporary, path) == -1) {
+            unlink(temporary);
+        }
+    }
+}
+
+/**
+ * Frees every entry. Results on disk are kept.
+ */
+static inline void resultCacheFree(ResultCache *cache) {
+    while (cache->oldest != NULL) {
+        cacheEvictOldest(cache);
+    }
+    free(cache->buckets);
+    cache->buckets = NULL;
+    cache->limit = 0;
+}
+
+#endif
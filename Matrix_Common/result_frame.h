@@ -0,0 +1,199 @@
+/**
+* Description: Framed binary result messages that children send to a parent over one shared pipe.
+* A frame is a header naming the job, the row and the first column, followed by the row's values
+* as int32; a frame with no values for row RESULT_ROW_DONE ends the job. Each frame goes out in a
+* single write of at most PIPE_BUF bytes, which the kernel never splits or interleaves with other
+* writers, so any number of children can share the pipe and the parent reads whole frames and adds
+* them into its result without parsing any text.
+* The parent names the pipe's write end in MATRIX_RESULT_FD, and numbers the jobs it hands out.
+* Jobs travel the other way as binary records on a control pipe: the job number and the lengths of
+* the A and W file names, followed by the names themselves, so a name may hold any character.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef RESULT_FRAME_H
+#define RESULT_FRAME_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "matrix_io.h"
+
+// Environment variable naming the frame pipe
+#define RESULT_FD_ENV "MATRIX_RESULT_FD"
+
+// Row of the frame that ends a job
+#define RESULT_ROW_DONE UINT32_MAX
+
+typedef struct {
+    uint32_t job;    // Job the values belong to, as numbered by the parent
+    uint32_t row;    // Row of the result the values belong to
+    uint32_t column; // Column of the first value
+    uint32_t count;  // Values that follow the header
+} ResultFrameHeader;
+
+// Most values one frame carries while staying a single atomic pipe write
+#define RESULT_FRAME_VALUES ((PIPE_BUF - sizeof(ResultFrameHeader)) / sizeof(int32_t))
+
+// A job on a control pipe; aLength and wLength bytes of the two names follow it
+typedef struct {
+    uint32_t job;
+    uint32_t aLength; // 0 for the running A the parent keeps in shared memory
+    uint32_t wLength;
+} JobRecord;
+
+/**
+ * Called in a forked child before exec: names the frame pipe's write end in the environment.
+ * Returns 0, or -1 on failure.
+ */
+static inline int shareResultChannel(int fd) {
+    char value[12];
+    snprintf(value, sizeof(value), "%d", fd);
+    return setenv(RESULT_FD_ENV, value, 1);
+}
+
+/**
+ * Returns the frame pipe named by MATRIX_RESULT_FD, or -1 when the process was not started with one.
+ */
+static inline int attachResultChannel(void) {
+    const char *fd = getenv(RESULT_FD_ENV);
+    if (fd == NULL || *fd == '\0') {
+        return -1;
+    }
+    return atoi(fd);
+}
+
+/**
+ * Sends count values of one row, starting at column 0, as one frame per RESULT_FRAME_VALUES values.
+ * Returns 0, or -1 if the pipe cannot be written.
+ */
+static inline int sendResultRow(int fd, uint32_t job, uint32_t row, const int32_t *values, size_t count) {
+    struct {
+        ResultFrameHeader header;
+        int32_t values[RESULT_FRAME_VALUES];
+    } frame;
+
+    size_t column = 0;
+    do {
+        size_t part = count - column < RESULT_FRAME_VALUES ? count - column : RESULT_FRAME_VALUES;
+        frame.header.job = job;
+        frame.header.row = row;
+        frame.header.column = (uint32_t)column;
+        frame.header.count = (uint32_t)part;
+        memcpy(frame.values, values + column, part * sizeof(int32_t));
+        if (writeFully(fd, &frame, sizeof(ResultFrameHeader) + part * sizeof(int32_t)) == -1) {
+            return -1;
+        }
+        column += part;
+    } while (column < count);
+    return 0;
+}
+
+/**
+ * Sends the frame that tells the parent every row of the job has been sent.
+ * Returns 0, or -1 if the pipe cannot be written.
+ */
+static inline int sendResultDone(int fd, uint32_t job) {
+    ResultFrameHeader header = {job, RESULT_ROW_DONE, 0, 0};
+    return writeFully(fd, &header, sizeof(header));
+}
+
+/**
+ * Sends one job record with its A and W file names; an A_file of NULL names the shared A.
+ * Returns 0, or -1 if a name is too long or the pipe cannot be written.
+ */
+static inline int sendJobRecord(int fd, uint32_t job, const char *A_file, const char *W_file) {
+    const size_t aLength = A_file != NULL ? strlen(A_file) : 0;
+    const size_t wLength = strlen(W_file);
+    if (aLength >= PATH_MAX || wLength >= PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    char record[sizeof(JobRecord) + 2 * PATH_MAX];
+    JobRecord header = {job, (uint32_t)aLength, (uint32_t)wLength};
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), A_file != NULL ? A_file : "", aLength);
+    memcpy(record + sizeof(header) + aLength, W_file, wLength);
+    return writeFully(fd, record, sizeof(header) + aLength + wLength);
+}
+
+/**
+ * Reads the next name of length bytes into name, which holds PATH_MAX bytes, and NUL-terminates it.
+ * A name too long to hold is read and dropped, leaving name empty, so the job still ends normally
+ * with an error instead of taking the stream out of step. Returns 0, or -1 if the pipe closed early.
+ */
+static inline int receiveJobName(int fd, char *name, uint32_t length) {
+    if (length < PATH_MAX) {
+        name[length] = '\0';
+        return readFully(fd, name, length);
+    }
+
+    name[0] = '\0';
+    char discard[512];
+    while (length > 0) {
+        uint32_t part = length < sizeof(discard) ? length : (uint32_t)sizeof(discard);
+        if (readFully(fd, discard, part) == -1) {
+            return -1;
+        }
+        length -= part;
+    }
+    return 0;
+}
+
+/**
+ * Reads the next job record into record and its names into A_file and W_file, which hold PATH_MAX
+ * bytes each. Returns 1 for a job, 0 once the parent has closed the pipe, and -1 on a read error.
+ */
+static inline int receiveJobRecord(int fd, JobRecord *record, char *A_file, char *W_file) {
+    ssize_t n;
+    do {
+        n = read(fd, record, sizeof(*record));
+    } while (n == -1 && errno == EINTR);
+    if (n == 0) {
+        return 0;
+    }
+    if (n == -1 || (n < (ssize_t)sizeof(*record) &&
+                    readFully(fd, (char *)record + n, sizeof(*record) - (size_t)n) == -1)) {
+        return -1;
+    }
+    if (receiveJobName(fd, A_file, record->aLength) == -1 || receiveJobName(fd, W_file, record->wLength) == -1) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * Reads the next frame into header and values, which holds RESULT_FRAME_VALUES values.
+ * Returns 1 for a frame, 0 once every writer has closed the pipe, and -1 on a read error or a
+ * malformed frame.
+ */
+static inline int receiveResultFrame(int fd, ResultFrameHeader *header, int32_t *values) {
+    ssize_t n;
+    do {
+        n = read(fd, header, sizeof(*header));
+    } while (n == -1 && errno == EINTR);
+    if (n == 0) {
+        return 0;
+    }
+
+    // A frame is written at once, so the rest of it is already in the pipe
+    if (n == -1 || (n < (ssize_t)sizeof(*header) &&
+                    readFully(fd, (char *)header + n, sizeof(*header) - (size_t)n) == -1)) {
+        return -1;
+    }
+    if (header->count > RESULT_FRAME_VALUES ||
+        readFully(fd, values, header->count * sizeof(int32_t)) == -1) {
+        return -1;
+    }
+    return 1;
+}
+
+#endif
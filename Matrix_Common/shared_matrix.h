@@ -0,0 +1,99 @@
+/**
+* Description: A matrix in shared memory that a parent updates and its exec'ed children read.
+* The matrix lives in a memfd that children keep across execv and map again from the descriptor
+* named by MATRIX_SHARED_FD, so a value the parent stores is seen by every child without going
+* through a file. The parent only writes it while no child is reading it, for example between
+* rounds of jobs, so no locking is needed.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef SHARED_MATRIX_H
+#define SHARED_MATRIX_H
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Environment variable naming the matrix descriptor a child inherits
+#define SHARED_MATRIX_ENV "MATRIX_SHARED_FD"
+
+typedef struct {
+    int rows;
+    int cols;
+    int data[]; // rows x cols, row-major
+} SharedMatrix;
+
+/**
+ * Returns the bytes a rows x cols shared matrix occupies.
+ */
+static inline size_t sharedMatrixSize(int rows, int cols) {
+    return sizeof(SharedMatrix) + (size_t)rows * cols * sizeof(int);
+}
+
+/**
+ * Creates a zero-filled rows x cols matrix in a new memfd and names the descriptor in
+ * MATRIX_SHARED_FD, so children started afterwards inherit both. Returns NULL on failure.
+ */
+static inline SharedMatrix *createSharedMatrix(int rows, int cols) {
+    int fd = (int)syscall(SYS_memfd_create, "matrix-shared", 0);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    size_t size = sharedMatrixSize(rows, cols);
+    SharedMatrix *matrix = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        matrix = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    char name[12];
+    snprintf(name, sizeof(name), "%d", fd);
+    if (matrix == MAP_FAILED || setenv(SHARED_MATRIX_ENV, name, 1) == -1) {
+        if (matrix != MAP_FAILED) {
+            munmap(matrix, size);
+        }
+        close(fd);
+        return NULL;
+    }
+    matrix->rows = rows;
+    matrix->cols = cols;
+    return matrix;
+}
+
+/**
+ * Maps the matrix named by MATRIX_SHARED_FD read-only. Returns NULL when the variable is not set
+ * or the matrix cannot be mapped.
+ */
+static inline const SharedMatrix *attachSharedMatrix(void) {
+    const char *name = getenv(SHARED_MATRIX_ENV);
+    if (name == NULL || *name == '\0') {
+        return NULL;
+    }
+
+    int fd = atoi(name);
+    SharedMatrix *header = mmap(NULL, sizeof(SharedMatrix), PROT_READ, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED) {
+        return NULL;
+    }
+    size_t size = sharedMatrixSize(header->rows, header->cols);
+    munmap(header, sizeof(SharedMatrix));
+
+    SharedMatrix *matrix = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    return matrix == MAP_FAILED ? NULL : matrix;
+}
+
+/**
+ * Unmaps a shared matrix. The descriptor stays open, so children started later can still map it.
+ */
+static inline void unmapSharedMatrix(const SharedMatrix *matrix) {
+    if (matrix != NULL) {
+        munmap((void *)matrix, sharedMatrixSize(matrix->rows, matrix->cols));
+    }
+}
+
+#endif
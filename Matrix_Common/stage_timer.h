@@ -0,0 +1,121 @@
+/**
+* Description: Per-stage latency timers and a JSON-lines trace shared by the coordinators and their children.
+* Stages are timed with the monotonic clock. When the MATRIX_TRACE environment variable names a
+* file, every process appends one JSON object per line to it, each written with a single
+* O_APPEND write so lines from concurrent processes never interleave. Without MATRIX_TRACE
+* nothing is written.
+* Header-only so every program can keep building with a single gcc command.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Environment variable naming the trace file
+#define TRACE_ENV "MATRIX_TRACE"
+
+// Longest trace line, including the fields every line starts with
+#define TRACE_LINE_SIZE 1024
+
+/**
+ * Returns the monotonic clock in nanoseconds.
+ */
+static inline uint64_t monotonicNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Returns the microseconds since *mark and moves *mark to now, so consecutive calls time
+ * consecutive stages.
+ */
+static inline double lapMicros(uint64_t *mark) {
+    uint64_t now = monotonicNanos();
+    double micros = (now - *mark) / 1000.0;
+    *mark = now;
+    return micros;
+}
+
+/**
+ * Returns the trace file descriptor, opening MATRIX_TRACE on first use, or -1 if tracing is off.
+ */
+static inline int traceFd(void) {
+    static int fd = -2;
+    if (fd == -2) {
+        const char *path = getenv(TRACE_ENV);
+        fd = (path != NULL && *path != '\0') ? open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644) : -1;
+    }
+    return fd;
+}
+
+/**
+ * Returns 1 if tracing is on.
+ */
+static inline int traceEnabled(void) {
+    return traceFd() != -1;
+}
+
+/**
+ * Copies text into out as the body of a JSON string, escaping quotes, backslashes and control
+ * characters, and truncating to fit size. Returns out.
+ */
+static inline const char *jsonEscape(const char *text, char *out, size_t size) {
+    size_t used = 0;
+    for (; *text != '\0' && used + 7 < size; text++) {
+        unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\') {
+            out[used++] = '\\';
+            out[used++] = c;
+        } else if (c < 0x20) {
+            used += snprintf(out + used, size - used, "\\u%04x", c);
+        } else {
+            out[used++] = c;
+        }
+    }
+    out[used] = '\0';
+    return out;
+}
+
+/**
+ * Appends one JSON object to the trace. format supplies the fields after the common "t_us"
+ * (monotonic time) and "pid" ones, without braces, for example "\"role\": \"child\", \"job\": %d".
+ * Does nothing when tracing is off.
+ */
+__attribute__((format(printf, 1, 2)))
+static inline void traceRecord(const char *format, ...) {
+    int fd = traceFd();
+    if (fd == -1) {
+        return;
+    }
+
+    char line[TRACE_LINE_SIZE];
+    int used = snprintf(line, sizeof(line), "{\"t_us\": %.3f, \"pid\": %d, ", monotonicNanos() / 1000.0, (int)getpid());
+
+    va_list args;
+    va_start(args, format);
+    used += vsnprintf(line + used, sizeof(line) - used, format, args);
+    va_end(args);
+
+    // Keep room for the closing brace when the fields were truncated
+    if (used > (int)sizeof(line) - 3) {
+        used = sizeof(line) - 3;
+    }
+    line[used++] = '}';
+    line[used++] = '\n';
+
+    if (write(fd, line, used) == -1) {
+        // The trace is best effort; a failed write must not fail the job
+    }
+}
+
+#endif
@@ -0,0 +1,58 @@
+/**
+* Description: This module converts matrix files between the text format (space-separated values,
+* one row per line) and the binary, memory-mappable format read by every matrix program.
+* The direction is chosen from the input: text input is written as binary, binary input as text.
+* Last modified date: 10/18/2026
+* Creation date: 10/18/2026
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../Matrix_Common/matrix_io.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <input_matrix_file> <output_matrix_file>\n", argv[0]);
+        exit(1);
+    }
+
+    FILE *input = fopen(argv[1], "r");
+    if (input == NULL) {
+        fprintf(stderr, "Error opening file %s.\n", argv[1]);
+        exit(1);
+    }
+
+    MatrixFileHeader header;
+    int binaryInput = sniffMatrixFile(input, &header);
+
+    MatrixView matrix;
+    if (binaryInput == -1 || openMatrixFile(input, &matrix) == -1) {
+        fprintf(stderr, "Error reading matrix file %s.\n", argv[1]);
+        fclose(input);
+        exit(1);
+    }
+    fclose(input);
+
+    FILE *output = fopen(argv[2], "w");
+    if (output == NULL) {
+        fprintf(stderr, "Error opening file %s.\n", argv[2]);
+        closeMatrix(&matrix);
+        exit(1);
+    }
+
+    int status = binaryInput ? writeMatrixText(output, matrix.data, matrix.rows, matrix.cols)
+                             : writeMatrixBinary(output, matrix.data, matrix.rows, matrix.cols);
+
+    if (fclose(output) != 0 || status == -1) {
+        fprintf(stderr, "Error writing file %s.\n", argv[2]);
+        closeMatrix(&matrix);
+        exit(1);
+    }
+
+    printf("Converted %s (%s) to %s (%s): %d x %d\n", argv[1], binaryInput ? "binary" : "text",
+           argv[2], binaryInput ? "text" : "binary", matrix.rows, matrix.cols);
+
+    closeMatrix(&matrix);
+    return 0;
+}
@@ -1,7 +1,15 @@
 /**
 * Description: This module performs matrix multiplication using parallel processes, creating child processes for each row of the matrix and utilizing inter-process communication through pipes.
 * It also handles input matrices from files and dynamically allocates memory for the results.
-* Last modified date: 12/05/2023
+* File names reach each child through a shared-memory job ring, or through its pipe when the ring cannot be created.
+* An epoll loop hands them out: each child has a bounded queue of names waiting for room, and input is paused
+* while any queue is full, so a slow child holds back only its own queue until that fills.
+* With -j N, every (A, Wi) pair becomes a job on one shared queue instead, pulled by whichever of N workers is free;
+* each worker loads and packs a W the first time it needs it and keeps it for later jobs.
+* Each A is parsed once into a shared-memory matrix store that every child maps instead of parsing it again.
+* Status lines go to PID.out and PID.err through an asynchronous logger that syncs them in batches; MATRIX_LOG_DURABILITY picks none, batch or sync.
+* With MATRIX_TRACE set, the time each job spends waiting on stdin and being dispatched to the children is traced as JSON lines.
+* Last modified date: 10/18/2026
 * Creation date: 12/05/2023
 **/
 
@@ -13,22 +21,149 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <limits.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
 
-#define MAX_ROWS 8
-#define MAX_COLUMNS 8
-#define FILENAME_SIZE 15
+#include "../Matrix_Common/async_log.h"
+#include "../Matrix_Common/job_ring.h"
+#include "../Matrix_Common/matrix_kernels.h"
+#include "../Matrix_Common/matrix_store.h"
+#include "../Matrix_Common/stage_timer.h"
 
-int pipes[MAX_COLUMNS][2];
+#define FILENAME_SIZE 24
+#define MAX_WORKERS 64
+
+// Names a child may have waiting for room in its ring or pipe before input is paused
+#define CHILD_QUEUE_LIMIT 64
+
+// Events taken from epoll per wait
+#define MAX_EVENTS 64
+
+// Bytes read from stdin at a time
+#define INPUT_BLOCK 4096
+
+// Rows value of a JobResult whose job failed; no values follow it
+#define RESULT_FAILED -1
+
+// One (A, W) pair on the shared job queue. Records are PIPE_BUF bytes, so a write is atomic and every
+// read by any worker returns one whole record.
+typedef struct {
+    int aIndex; // 0 is the A from the command line, then the A files from stdin in order; -1 stops the worker
+    int wIndex;
+    uint32_t length;
+    char path[PIPE_BUF - 3 * sizeof(int)];
+} ScheduledJob;
+
+_Static_assert(sizeof(ScheduledJob) == PIPE_BUF, "ScheduledJob must be one atomic pipe write");
+
+// Sent back by a worker for every job, followed by rows x cols values unless rows is RESULT_FAILED
+typedef struct {
+    int aIndex;
+    int wIndex;
+    int rows;
+    int cols;
+} JobResult;
+
+// A W matrix as a worker keeps it between jobs
+typedef struct {
+    int state;         // 0 until first needed, 1 once packed, -1 if it could not be loaded
+    int innerDim;      // Columns every A is padded to
+    int resultColumns;
+    PackedMatrix packed;
+} CachedWeights;
+
+// A file name shared by every child queue that holds it. Length 0 ends the input.
+typedef struct {
+    int refs;
+    size_t length;
+    char text[];
+} QueuedName;
+
+// One W child: where its file names go and the names still waiting for room there
+typedef struct {
+    pid_t pid;
+    JobRing *ring;      // NULL when the child is fed through its pipe
+    int ringFd;         // memfd behind ring, until the child is forked
+    int pipe[2];        // The child's stdin pipe; the write end is non-blocking
+    QueuedName *queue[CHILD_QUEUE_LIMIT];
+    int queueHead;
+    int queueCount;
+    char *frame;        // Length-prefixed copy of the oldest name while it is written to the pipe
+    size_t frameLength;
+    size_t written;
+    int watching;       // 1 while epoll waits for the pipe to take more
+} ChildChannel;
+
+// A collected result; values stays NULL until it arrives
+typedef struct {
+    int *values;
+    int rows;
+    int cols;
+} ResultSlot;
+
+ChildChannel *channels;     // One per W child
+int epollFd;
 int realStdout;
 clock_t startClock, endClock, inputStart, inputEnd;
 double cpuTimeUsed, inputTime;
+uint64_t wallStart;         // Monotonic start of the run
+double stdinWaitMicros;     // Wall-clock time spent blocked on stdin
+double childrenMicros;      // Wall-clock time from the last dispatch until every child is reaped
+AsyncLog statusLog;         // Carries the status lines the coordinator appends to PID.out and PID.err
+int jobCount;               // A matrices read from stdin and dispatched
+
+int workerCount;            // Workers pulling (A, W) jobs from the shared queue; 0 gives every W its own child
+int jobPipe[2];             // Shared queue of ScheduledJob records read by every worker
+int resultPipes[MAX_WORKERS][2];
+int openResults;            // Workers whose result pipe is still open
+int weightCount;            // W matrices, so jobs per A
+ResultSlot *results;        // Indexed by aIndex * weightCount + wIndex
+char **aNames;              // A file of each aIndex
+int aCount;                 // A matrices queued, including the one from the command line
+int aCapacity;              // A matrices results and aNames have room for
+int jobsSent, jobsReceived, jobsFailed;
 
 int calculateMultiplication(char *inputMatrix, char **matrixList, const int matrixCount);
-int acceptMatrix(const int numMatrices);
+int acceptMatrix(void);
+int openChannels(const int count);
+int dispatchMatrices(const int count);
+int dispatchName(const char *aMatrix, size_t len, const int count);
+int flushChannel(const int child);
+int watchPipe(ChildChannel *channel, const int watching);
+void closeChannels(const int count);
+int scheduleJobs(char *inputMatrix, char **matrixList, const int matrixCount);
+int scheduleMatrix(const char *aMatrix, size_t len);
+int sendJob(const ScheduledJob *job);
+int collectResults(const int timeout, const int queueFull);
+int finishSchedule();
+int writeResults(char *inputMatrix, char **matrixList);
+void runWorker(const int resultFd, const char *inputMatrix, char **matrixList);
+int loadWeights(CachedWeights *weights, const char *wFile, const int firstColumns);
+int computeJob(CachedWeights *weights, const ScheduledJob *job, JobResult *header, int **values);
+int reapChildren(const int count);
 void releaseMemory(char **dynamicMatrix, const int items);
 
 int main(int argc, char *argv[]) {
     startClock = clock();
+    wallStart = monotonicNanos();
+    logInit(&statusLog);
+
+    // -j N switches to the shared job queue with N workers; -s makes the children stream their results
+    int option;
+    while ((option = getopt(argc, argv, "+j:s")) != -1) {
+        if (option == 's') {
+            setenv("MATRIX_STREAM", "1", 1);
+        } else if (option != 'j' || (workerCount = atoi(optarg)) < 1 || workerCount > MAX_WORKERS) {
+            fprintf(stderr, "Usage: %s [-s] [-j workers (1-%d)] A W1 [W2 ...]\n", argv[0], MAX_WORKERS);
+            return 1;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
     if (argc < 3) {
         fprintf(stderr, "You must pass in at least 2 matrices as input.\n");
         return 1;
@@ -37,12 +172,11 @@ int main(int argc, char *argv[]) {
     realStdout = dup(STDOUT_FILENO);
 
     int numMatrices = argc - 2;
-    // Create pipes for IPC.
-    for (int i = 0; i < numMatrices; ++i) {
-        if (pipe(pipes[i]) == -1) {
-            fprintf(stderr, "Pipe creation failed.\n");
-            return 1;
-        }
+
+    // Create pipes and job rings for IPC.
+    if (workerCount == 0 && openChannels(numMatrices) == 1) {
+        fprintf(stderr, "Pipe creation failed.\n");
+        return 1;
     }
 
     char **matrixList = (char **)malloc(sizeof(char *) * numMatrices);
@@ -56,7 +190,16 @@ int main(int argc, char *argv[]) {
         matrixList[i] = strdup(argv[i + 2]);
     }
 
-    if (calculateMultiplication(argv[1], matrixList, numMatrices) == 1) {
+    // Every A is parsed once into the matrix store and mapped by each child that needs it
+    createMatrixStore();
+    publishMatrix(argv[1]);
+
+    int status = workerCount > 0 ? scheduleJobs(argv[1], matrixList, numMatrices)
+                                 : calculateMultiplication(argv[1], matrixList, numMatrices);
+
+    // A forked child that failed before exec returns here too; only the creator removes the store
+    removeMatrixStore();
+    if (status == 1) {
         fprintf(stderr, "Multiplication calculation failed. Refer to prior messages for cause.\n");
         releaseMemory(matrixList, numMatrices);
         return 1;
@@ -70,6 +213,11 @@ int main(int argc, char *argv[]) {
 
     printf("\nRuntime: %f secs\n", cpuTimeUsed);
 
+    traceRecord("\"role\": \"coordinator\", \"event\": \"total\", \"children\": %d, \"jobs\": %d, "
+                "\"wall_us\": %.3f, \"stdin_wait_us\": %.3f, \"children_us\": %.3f",
+                workerCount > 0 ? workerCount : numMatrices, jobCount, (monotonicNanos() - wallStart) / 1000.0,
+                stdinWaitMicros, childrenMicros);
+
     return 0;
 }
 
@@ -86,22 +234,15 @@ int calculateMultiplication(char *inputMatrix, char **matrixList, const int matr
             fprintf(stderr, "fork() failed.\n");
             return 1;
         } else if (pid == 0) {
-            // Close all unnecessary read and write ends of the pipe.
-            for (int j = 0; j < MAX_COLUMNS; ++j) {
-                if (j != i) {
-                    close(pipes[j][0]);
-                    close(pipes[j][1]);
-                }
-            }
-
+            // Every other child's pipe and ring is closed on exec.
             pid_t childPID = getpid();
 
             snprintf(outFile, FILENAME_SIZE, "%d.out", childPID);
             snprintf(errFile, FILENAME_SIZE, "%d.err", childPID);
 
             // Create the actual files on disk, open in write only and append mode
-            outFD = open(outFile, O_WRONLY | O_CREAT | O_APPEND | O_DSYNC, 0644);
-            errFD = open(errFile, O_WRONLY | O_CREAT | O_APPEND | O_DSYNC, 0644);
+            outFD = open(outFile, O_WRONLY | O_CREAT | O_APPEND | logOpenFlags(&statusLog), 0644);
+            errFD = open(errFile, O_WRONLY | O_CREAT | O_APPEND | logOpenFlags(&statusLog), 0644);
 
             // Redirect stderr and stdout to errFile and outFile
             if ((dup2(errFD, STDERR_FILENO) == -1) || (dup2(outFD, STDOUT_FILENO) == -1)) {
@@ -113,7 +254,7 @@ int calculateMultiplication(char *inputMatrix, char **matrixList, const int matr
             fflush(stdout);
 
             // Redirect stdin to the read end of the pipe.
-            if (dup2(pipes[i][0], STDIN_FILENO) == -1) {
+            if (dup2(channels[i].pipe[0], STDIN_FILENO) == -1) {
                 fprintf(stderr, "Redirecting stdin and stdout to pipe read and write ends failed.\n");
                 return 1;
             }
@@ -121,17 +262,30 @@ int calculateMultiplication(char *inputMatrix, char **matrixList, const int matr
             char realSOUT[12];
             snprintf(realSOUT, sizeof(realSOUT), "%d", realStdout);
 
+            // Keep this child's job ring open across exec and tell it where to find it
+            if (channels[i].ring != NULL && shareJobRing(channels[i].ring, channels[i].ringFd) == -1) {
+                fprintf(stderr, "Passing the job ring to the child failed.\n");
+                return 1;
+            }
+
             char *args[] = {"matrixmult_parallel", inputMatrix, matrixList[i], realSOUT, NULL};
             if (execv("./matrixmult_parallel", args) == -1) {
                 // Error handling.
                 fprintf(stderr, "execv() failed. Command tried to execute: %s %s %s %s\n", "./matrixmult_parallel", args[1], args[2], args[3]);
                 close(outFD);
                 close(errFD);
-                close(pipes[i][0]);
-                close(pipes[i][1]);
                 return 1;
             }
         }
+        channels[i].pid = pid;
+
+        // The child holds its own ends; the parent only needs the write end and its ring mapping
+        close(channels[i].pipe[0]);
+        channels[i].pipe[0] = -1;
+        if (channels[i].ring != NULL) {
+            close(channels[i].ringFd);
+            channels[i].ringFd = -1;
+        }
     }
 
     if (dup2(realStdout, STDOUT_FILENO) == -1) {
@@ -139,13 +293,24 @@ int calculateMultiplication(char *inputMatrix, char **matrixList, const int matr
         return 1;
     }
 
-    if (acceptMatrix(matrixCount) == 1) {
+    int dispatched = dispatchMatrices(matrixCount);
+    closeChannels(matrixCount);
+    if (dispatched == 1) {
         fprintf(stdout, "Sending matrices from stdin failed. Refer to prior messages for cause.\n");
         return 1;
     }
 
     // Parent process
-    for (int i = 0; i < matrixCount; ++i) {
+    return reapChildren(matrixCount);
+}
+
+// Waits for count children, appending how each ended to its PID.out and PID.err. Returns 1 on failure.
+int reapChildren(const int count) {
+    char outFile[FILENAME_SIZE];
+    char errFile[FILENAME_SIZE];
+
+    uint64_t reapStart = monotonicNanos();
+    for (int i = 0; i < count; ++i) {
         int wstatus;
         int childPID = wait(&wstatus); // Wait for each child process to end.
 
@@ -153,50 +318,43 @@ int calculateMultiplication(char *inputMatrix, char **matrixList, const int matr
         snprintf(outFile, FILENAME_SIZE, "%d.out", childPID);
         snprintf(errFile, FILENAME_SIZE, "%d.err", childPID);
 
-        outFD = open(outFile, O_WRONLY | O_APPEND | O_DSYNC, 0644);
-        errFD = open(errFile, O_WRONLY | O_APPEND | O_DSYNC, 0644);
-
-        // Redirect stdout and stderr to out_file and err_file.
-        dup2(outFD, STDOUT_FILENO);
-        dup2(errFD, STDERR_FILENO);
+        // The lines go through the log, which writes and syncs them in batches and closes the files after
+        int outFD = open(outFile, O_WRONLY | O_APPEND | O_CLOEXEC | logOpenFlags(&statusLog), 0644);
+        int errFD = open(errFile, O_WRONLY | O_APPEND | O_CLOEXEC | logOpenFlags(&statusLog), 0644);
 
-        fprintf(stdout, "Finished child %d pid of parent %d\n", childPID, getpid());
-        fflush(stdout);
+        if (outFD != -1) {
+            logPrintf(&statusLog, outFD, "Finished child %d pid of parent %d\n", childPID, getpid());
+        }
 
         if (WIFEXITED(wstatus)) {
             int exitStatus = WEXITSTATUS(wstatus); // Store exit code of child process.
 
-            if (exitStatus == 0) {
-                fprintf(stdout, "Exited with exitcode = %d\n", exitStatus);
-                fflush(stdout);
-            } else {
-                fprintf(stderr, "Exited with exitcode = %d\n", exitStatus);
+            if (exitStatus == 0 && outFD != -1) {
+                logPrintf(&statusLog, outFD, "Exited with exitcode = %d\n", exitStatus);
+            } else if (exitStatus != 0 && errFD != -1) {
+                logPrintf(&statusLog, errFD, "Exited with exitcode = %d\n", exitStatus);
             }
-        } else if (WIFSIGNALED(wstatus)) {
-            fprintf(stderr, "Killed with signal %d\n", WTERMSIG(wstatus));
+        } else if (WIFSIGNALED(wstatus) && errFD != -1) {
+            logPrintf(&statusLog, errFD, "Killed with signal %d\n", WTERMSIG(wstatus));
         }
 
-        fflush(stdout);
-        fflush(stderr);
-
-        // Close read end of pipe.
-        close(pipes[i][0]);
+        logCloseFile(&statusLog, outFD);
+        logCloseFile(&statusLog, errFD);
     }
 
-    if (dup2(realStdout, STDOUT_FILENO) == -1) {
-        fprintf(stderr, "Redirecting stdout to terminal failed.\n");
+    // Every status line is on disk, as far as the durability asks, before the run is reported done
+    if (logShutdown(&statusLog) == -1) {
+        fprintf(stderr, "Writing the status logs failed: %s\n", strerror(errno));
+        childrenMicros = lapMicros(&reapStart);
         return 1;
     }
-
-    // Close all file descriptors
-    close(outFD);
-    close(errFD);
+    childrenMicros = lapMicros(&reapStart);
 
     return 0;
 }
 
-// accept matrices from stdin and then passes them off to the child processes.
-int acceptMatrix(const int matrixCount) {
+// accept matrices from stdin and then queues them as jobs for the workers.
+int acceptMatrix(void) {
     char *aMatrix = NULL;
     size_t bufferLen = 0;
 
@@ -204,10 +362,13 @@ int acceptMatrix(const int matrixCount) {
     fflush(stdout);
 
     inputStart = clock();
+    uint64_t mark = monotonicNanos();
 
     while (getline(&aMatrix, &bufferLen, stdin) != -1) {
         inputEnd = clock();
         inputTime += ((double)(inputEnd - inputStart)) / CLOCKS_PER_SEC;
+        double stdinWait = lapMicros(&mark);
+        stdinWaitMicros += stdinWait;
         size_t len = strlen(aMatrix);
 
         // Remove the trailing newline character.
@@ -217,18 +378,20 @@ int acceptMatrix(const int matrixCount) {
         }
 
         if (len > 0) {
-            for (int i = 0; i < matrixCount; ++i) {
-                // Pass the length of the file passed to each child process.
-                if (write(pipes[i][1], &len, sizeof(size_t)) == -1) {
-                    fprintf(stderr, "Sending length of matrix %s text to child %d failed.\n", aMatrix, i);
-                    return 1;
-                }
+            // Queue one job per W for whichever workers are free.
+            if (scheduleMatrix(aMatrix, len) == 1) {
+                fprintf(stderr, "Queueing matrix %s failed.\n", aMatrix);
+                free(aMatrix);
+                return 1;
+            }
 
-                // Pass the filename to each child process.
-                if (write(pipes[i][1], aMatrix, len) == -1) {
-                    fprintf(stderr, "Sending matrix %s to child %d failed.\n", aMatrix, i);
-                    return 1;
-                }
+            // Jobs are numbered from 1 like in the children; job 0 is the A from the command line
+            jobCount++;
+            if (traceEnabled()) {
+                char name[256];
+                traceRecord("\"role\": \"coordinator\", \"event\": \"job\", \"job\": %d, \"a\": \"%s\", "
+                            "\"stdin_wait_us\": %.3f, \"dispatch_us\": %.3f",
+                            jobCount, jsonEscape(aMatrix, name, sizeof(name)), stdinWait, lapMicros(&mark));
             }
         }
 
@@ -238,26 +401,703 @@ int acceptMatrix(const int matrixCount) {
         bufferLen = 0;
         fprintf(stdout, "Enter file path of a matrix (Ctrl+D to exit): \n");
         inputStart = clock();
+        mark = monotonicNanos();
     }
 
     inputEnd = clock();
     inputTime += ((double)(inputEnd - inputStart)) / CLOCKS_PER_SEC;
+    stdinWaitMicros += lapMicros(&mark);
 
-    for (int i = 0; i < matrixCount; ++i) {
-        bufferLen = 0;
-        if (write(pipes[i][1], &bufferLen, sizeof(size_t)) == -1) {
-            fprintf(stderr, "Sending EOF to child %d failed.\n", i);
+    if (aMatrix != NULL) {
+        free(aMatrix);
+        aMatrix = NULL;
+    }
+
+    return finishSchedule();
+}
+
+// Creates the stdin pipe and job ring of every W child. Every descriptor is closed on exec, so each
+// child keeps only its own. Returns 1 on failure.
+int openChannels(const int count) {
+    // Two descriptors stay open per child, so make sure hundreds of children fit
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max &&
+        files.rlim_cur < (rlim_t)count * 4 + 64) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    channels = calloc(count, sizeof(ChildChannel));
+    if (channels == NULL) {
+        return 1;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (pipe(channels[i].pipe) == -1) {
             return 1;
         }
+        fcntl(channels[i].pipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(channels[i].pipe[1], F_SETFD, FD_CLOEXEC);
+        fcntl(channels[i].pipe[1], F_SETFL, fcntl(channels[i].pipe[1], F_GETFL) | O_NONBLOCK);
 
-        close(pipes[i][1]);
+        // A child whose ring cannot be created falls back to the pipe
+        channels[i].ring = createJobRing(&channels[i].ringFd);
     }
+    return 0;
+}
 
-    if (aMatrix != NULL) {
-        free(aMatrix);
-        aMatrix = NULL;
+// Reads file names from stdin and hands each to every child, waiting on epoll for room in full rings
+// and pipes. Returns 1 on failure.
+int dispatchMatrices(const int count) {
+    char *input = NULL;   // Bytes read from stdin that are not yet a whole line
+    size_t inputUsed = 0;
+    size_t inputSize = 0;
+    int inputEnded = 0;   // stdin reached EOF
+    int inputOpen = 1;    // The end of input is not yet queued
+    int stdinReady = 0;
+    int stdinWatched = 1; // Regular files cannot be watched by epoll and are always ready
+    int status = 0;
+    struct epoll_event events[MAX_EVENTS];
+
+    // A child dying early must show up as a failed write, not kill the coordinator.
+    signal(SIGPIPE, SIG_IGN);
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {EPOLLIN, {.u32 = 0}};
+    int rc = epollFd == -1 ? -1 : epoll_ctl(epollFd, EPOLL_CTL_ADD, STDIN_FILENO, &event);
+    if (rc == -1 && (epollFd == -1 || errno != EPERM)) {
+        fprintf(stderr, "epoll setup failed.\n");
+        return 1;
+    }
+    stdinWatched = rc == 0;
+    for (int i = 0; i < count; ++i) {
+        event.events = EPOLLIN;
+        event.data.u32 = i + 1;
+        if (channels[i].ring != NULL && epoll_ctl(epollFd, EPOLL_CTL_ADD, channels[i].ring->spaceEvent, &event) == -1) {
+            fprintf(stderr, "epoll setup failed.\n");
+            return 1;
+        }
+    }
+
+    fprintf(stdout, "Enter file path of a matrix: \n");
+    fflush(stdout);
+
+    inputStart = clock();
+    uint64_t mark = monotonicNanos();
+    uint64_t lastCheck = mark;
+    int stdinEvents = EPOLLIN;
+
+    while (status == 0) {
+        int waiting = 0;
+        int full = 0;
+        for (int i = 0; i < count; ++i) {
+            waiting += channels[i].queueCount > 0;
+            full += channels[i].queueCount == CHILD_QUEUE_LIMIT;
+        }
+        if (!inputOpen && waiting == 0) {
+            break;
+        }
+
+        // Hand out the lines already read while every child has room for one more name
+        char *lineEnd;
+        if (inputOpen && full == 0 && (lineEnd = memchr(input, '\n', inputUsed)) != NULL) {
+            inputEnd = clock();
+            inputTime += ((double)(inputEnd - inputStart)) / CLOCKS_PER_SEC;
+            double stdinWait = lapMicros(&mark);
+            stdinWaitMicros += stdinWait;
+
+            size_t len = lineEnd - input;
+            *lineEnd = '\0';
+            if (len > 0) {
+                publishMatrix(input);
+                status = dispatchName(input, len, count);
+
+                // Jobs are numbered from 1 like in the children; job 0 is the A from the command line
+                jobCount++;
+                if (traceEnabled()) {
+                    char name[256];
+                    traceRecord("\"role\": \"coordinator\", \"event\": \"job\", \"job\": %d, \"a\": \"%s\", "
+                                "\"stdin_wait_us\": %.3f, \"dispatch_us\": %.3f",
+                                jobCount, jsonEscape(input, name, sizeof(name)), stdinWait, lapMicros(&mark));
+                }
+            }
+
+            inputUsed -= len + 1;
+            memmove(input, lineEnd + 1, inputUsed);
+            fprintf(stdout, "Enter file path of a matrix (Ctrl+D to exit): \n");
+            inputStart = clock();
+            mark = monotonicNanos();
+            continue;
+        }
+
+        // Queue the end of input once every name before it is queued
+        if (inputOpen && inputEnded && full == 0) {
+            inputEnd = clock();
+            inputTime += ((double)(inputEnd - inputStart)) / CLOCKS_PER_SEC;
+            stdinWaitMicros += lapMicros(&mark);
+            status = dispatchName("", 0, count);
+            inputOpen = 0;
+            continue;
+        }
+
+        // Read more input only while no child queue is full
+        int wantInput = inputOpen && !inputEnded && full == 0;
+        if (stdinWatched && stdinEvents != (wantInput ? EPOLLIN : 0)) {
+            stdinEvents = wantInput ? EPOLLIN : 0;
+            event.events = stdinEvents;
+            event.data.u32 = 0;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, STDIN_FILENO, &event);
+        }
+        if (wantInput && (stdinReady || !stdinWatched)) {
+            if (inputSize - inputUsed < INPUT_BLOCK) {
+                char *grown = realloc(input, inputSize + INPUT_BLOCK);
+                if (grown == NULL) {
+                    fprintf(stderr, "Memory allocation failed for stdin.\n");
+                    status = 1;
+                    break;
+                }
+                input = grown;
+                inputSize += INPUT_BLOCK;
+            }
+
+            ssize_t n = read(STDIN_FILENO, input + inputUsed, inputSize - inputUsed - 1);
+            if (n > 0) {
+                inputUsed += n;
+            } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+                // A last line without a newline still counts, as with getline
+                if (inputUsed > 0) {
+                    input[inputUsed++] = '\n';
+                }
+                inputEnded = 1;
+            }
+            stdinReady = 0;
+            continue;
+        }
+
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, JOB_RING_POLL_MS);
+        for (int e = 0; e < ready && status == 0; ++e) {
+            if (events[e].data.u32 == 0) {
+                stdinReady = 1;
+                continue;
+            }
+
+            ChildChannel *channel = &channels[events[e].data.u32 - 1];
+            uint64_t signals;
+            if (channel->ring != NULL && read(channel->ring->spaceEvent, &signals, sizeof(signals)) == -1) {
+                // Already reset by an earlier event
+            }
+            status = flushChannel(events[e].data.u32 - 1);
+        }
+
+        // A child that died leaves its ring full without ever signalling, so look for it now and then
+        if (status == 0 && monotonicNanos() - lastCheck > JOB_RING_POLL_MS * 1000000ull) {
+            lastCheck = monotonicNanos();
+            for (int i = 0; i < count && status == 0; ++i) {
+                if (channels[i].queueCount > 0 && !peerAlive(channels[i].pid)) {
+                    fprintf(stderr, "Child %d exited before taking every matrix.\n", i + 1);
+                    status = 1;
+                }
+            }
+        }
+    }
+
+    free(input);
+    close(epollFd);
+    return status;
+}
+
+// Queues one file name, or the end of input when len is 0, for every child and sends what fits. Returns 1 on failure.
+int dispatchName(const char *aMatrix, size_t len, const int count) {
+    QueuedName *name = malloc(sizeof(QueuedName) + len + 1);
+    if (name == NULL) {
+        fprintf(stderr, "Memory allocation failed for matrix %s.\n", aMatrix);
+        return 1;
+    }
+    name->refs = count;
+    name->length = len;
+    memcpy(name->text, aMatrix, len + 1);
+
+    for (int i = 0; i < count; ++i) {
+        ChildChannel *channel = &channels[i];
+        channel->queue[(channel->queueHead + channel->queueCount) % CHILD_QUEUE_LIMIT] = name;
+        channel->queueCount++;
+    }
+
+    // Queue for all children before sending, so a failure never leaves the name half counted
+    int status = 0;
+    for (int i = 0; i < count && status == 0; ++i) {
+        status = flushChannel(i);
+    }
+    return status;
+}
+
+// Sends a child as many of its queued names as its ring or pipe takes without blocking. Returns 1 on failure.
+int flushChannel(const int child) {
+    ChildChannel *channel = &channels[child];
+
+    while (channel->queueCount > 0) {
+        QueuedName *name = channel->queue[channel->queueHead];
+
+        if (channel->ring != NULL) {
+            if (tryPushJob(channel->ring, name->text, name->length) == -1) {
+                if (errno == EAGAIN) {
+                    return 0; // The ring's eventfd wakes the loop once the child takes a name
+                }
+                fprintf(stderr, "Sending matrix %s to child %d failed.\n", name->text, child + 1);
+                return 1;
+            }
+        } else {
+            // Pass the length of the file, then the filename, as one frame that may take several writes.
+            if (channel->frame == NULL) {
+                channel->frameLength = sizeof(size_t) + name->length;
+                channel->frame = malloc(channel->frameLength);
+                if (channel->frame == NULL) {
+                    fprintf(stderr, "Memory allocation failed for matrix %s.\n", name->text);
+                    return 1;
+                }
+                memcpy(channel->frame, &name->length, sizeof(size_t));
+                memcpy(channel->frame + sizeof(size_t), name->text, name->length);
+                channel->written = 0;
+            }
+
+            ssize_t n = write(channel->pipe[1], channel->frame + channel->written, channel->frameLength - channel->written);
+            if (n == -1 && errno == EAGAIN) {
+                return watchPipe(channel, 1);
+            } else if (n == -1) {
+                fprintf(stderr, "Sending matrix %s to child %d failed.\n", name->text, child + 1);
+                return 1;
+            }
+
+            channel->written += n;
+            if (channel->written < channel->frameLength) {
+                continue;
+            }
+            free(channel->frame);
+            channel->frame = NULL;
+        }
+
+        channel->queueHead = (channel->queueHead + 1) % CHILD_QUEUE_LIMIT;
+        channel->queueCount--;
+        if (--name->refs == 0) {
+            free(name);
+        }
+    }
+
+    return channel->ring == NULL ? watchPipe(channel, 0) : 0;
+}
+
+// Starts or stops waiting on epoll for a child's pipe to take more. Returns 1 on failure.
+int watchPipe(ChildChannel *channel, const int watching) {
+    if (channel->watching == watching) {
+        return 0;
+    }
+
+    struct epoll_event event = {EPOLLOUT, {.u32 = (uint32_t)(channel - channels) + 1}};
+    if (epoll_ctl(epollFd, watching ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, channel->pipe[1], &event) == -1) {
+        fprintf(stderr, "epoll_ctl() failed for child %d.\n", (int)(channel - channels) + 1);
+        return 1;
+    }
+    channel->watching = watching;
+    return 0;
+}
+
+// Closes the parent's ends of every pipe and ring and drops the names still queued
+void closeChannels(const int count) {
+    for (int i = 0; i < count; ++i) {
+        ChildChannel *channel = &channels[i];
+        while (channel->queueCount > 0) {
+            QueuedName *name = channel->queue[channel->queueHead];
+            channel->queueHead = (channel->queueHead + 1) % CHILD_QUEUE_LIMIT;
+            channel->queueCount--;
+            if (--name->refs == 0) {
+                free(name);
+            }
+        }
+        free(channel->frame);
+        close(channel->pipe[1]);
+        if (channel->pipe[0] != -1) {
+            close(channel->pipe[0]);
+        }
+        unmapJobRing(channel->ring);
+    }
+    free(channels);
+    channels = NULL;
+}
+
+// Forks the workers, queues the command-line A and every A from stdin as one job per W, then writes the results.
+int scheduleJobs(char *inputMatrix, char **matrixList, const int matrixCount) {
+    char outFile[FILENAME_SIZE];
+    char errFile[FILENAME_SIZE];
+    weightCount = matrixCount;
+
+    // A worker that dies must show up as a failed write, not kill the coordinator.
+    signal(SIGPIPE, SIG_IGN);
+
+    if (pipe(jobPipe) == -1) {
+        fprintf(stderr, "Pipe creation failed.\n");
+        return 1;
+    }
+
+    fflush(stdout);
+    for (int i = 0; i < workerCount; ++i) {
+        if (pipe(resultPipes[i]) == -1) {
+            fprintf(stderr, "Pipe creation failed.\n");
+            return 1;
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "fork() failed.\n");
+            return 1;
+        } else if (pid == 0) {
+            // Keep only the shared queue's read end and this worker's result write end.
+            close(jobPipe[1]);
+            close(resultPipes[i][0]);
+            for (int j = 0; j < i; ++j) {
+                close(resultPipes[j][0]);
+            }
+
+            snprintf(outFile, FILENAME_SIZE, "%d.out", getpid());
+            snprintf(errFile, FILENAME_SIZE, "%d.err", getpid());
+            int outFD = open(outFile, O_WRONLY | O_CREAT | O_APPEND | logOpenFlags(&statusLog), 0644);
+            int errFD = open(errFile, O_WRONLY | O_CREAT | O_APPEND | logOpenFlags(&statusLog), 0644);
+            if ((dup2(errFD, STDERR_FILENO) == -1) || (dup2(outFD, STDOUT_FILENO) == -1)) {
+                fprintf(stderr, "Redirecting stderr and stdout failed.\n");
+                exit(1);
+            }
+
+            fprintf(stdout, "Starting worker %d: child %d pid of parent %d\n", i + 1, getpid(), getppid());
+            fflush(stdout);
+            runWorker(resultPipes[i][1], inputMatrix, matrixList);
+        }
+
+        close(resultPipes[i][1]);
+        openResults++;
+    }
+    close(jobPipe[0]);
+
+    // The coordinator never blocks on a full queue, so it can keep collecting results meanwhile.
+    fcntl(jobPipe[1], F_SETFL, fcntl(jobPipe[1], F_GETFL) | O_NONBLOCK);
+
+    if (scheduleMatrix(inputMatrix, strlen(inputMatrix)) == 1) {
+        fprintf(stderr, "Queueing matrix %s failed.\n", inputMatrix);
+        return 1;
+    }
+
+    int status = acceptMatrix();
+    if (status == 0) {
+        status = writeResults(inputMatrix, matrixList);
+    } else {
+        // Let the workers finish so they can be reaped.
+        close(jobPipe[1]);
+        while (openResults > 0 && collectResults(-1, 0) == 0) {
+        }
+    }
+
+    for (int i = 0; i < aCount; ++i) {
+        for (int j = 0; j < weightCount; ++j) {
+            free(results[i * weightCount + j].values);
+        }
+        free(aNames[i]);
+    }
+    free(results);
+    free(aNames);
+
+    return reapChildren(workerCount) == 1 ? 1 : status;
+}
+
+// Queues one job per W for the A in aMatrix. Returns 1 on failure.
+int scheduleMatrix(const char *aMatrix, size_t len) {
+    if (len >= sizeof(((ScheduledJob *)0)->path)) {
+        fprintf(stderr, "File name %s is too long.\n", aMatrix);
+        return 1;
+    }
+    publishMatrix(aMatrix);
+
+    if (aCount == aCapacity) {
+        int capacity = aCapacity == 0 ? 16 : aCapacity * 2;
+        ResultSlot *grownResults = realloc(results, sizeof(ResultSlot) * capacity * weightCount);
+        if (grownResults != NULL) {
+            results = grownResults;
+        }
+        char **grownNames = realloc(aNames, sizeof(char *) * capacity);
+        if (grownNames != NULL) {
+            aNames = grownNames;
+        }
+        if (grownResults == NULL || grownNames == NULL) {
+            fprintf(stderr, "Memory allocation failed for the results.\n");
+            return 1;
+        }
+        memset(results + aCapacity * weightCount, 0, sizeof(ResultSlot) * (capacity - aCapacity) * weightCount);
+        aCapacity = capacity;
+    }
+    aNames[aCount] = strndup(aMatrix, len);
+
+    ScheduledJob job;
+    memset(&job, 0, sizeof(job));
+    job.aIndex = aCount++;
+    job.length = (uint32_t)len;
+    memcpy(job.path, aMatrix, len);
+
+    for (int i = 0; i < weightCount; ++i) {
+        job.wIndex = i;
+        if (sendJob(&job) == 1) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Writes one record to the shared queue, collecting results while the queue is full. Returns 1 on failure.
+int sendJob(const ScheduledJob *job) {
+    while (write(jobPipe[1], job, sizeof(*job)) == -1) {
+        if (errno != EAGAIN || openResults == 0) {
+            fprintf(stderr, "No worker is left to take jobs.\n");
+            return 1;
+        }
+
+        // Collect results until a worker takes a job; a worker blocked on its result pipe cannot take one.
+        if (collectResults(-1, 1) == 1) {
+            return 1;
+        }
+    }
+
+    if (job->aIndex >= 0) {
+        jobsSent++;
+    }
+    return 0;
+}
+
+// Reads every result that is ready, waiting up to timeout milliseconds (-1 without limit) for the first.
+// With queueFull set, the wait also ends once the job queue has room. Returns 1 on a malformed result.
+int collectResults(const int timeout, const int queueFull) {
+    struct pollfd ready[MAX_WORKERS + 1];
+    for (int i = 0; i < workerCount; ++i) {
+        ready[i].fd = resultPipes[i][0];
+        ready[i].events = POLLIN;
+        ready[i].revents = 0;
+    }
+    ready[workerCount].fd = queueFull ? jobPipe[1] : -1;
+    ready[workerCount].events = POLLOUT;
+    ready[workerCount].revents = 0;
+
+    if (poll(ready, workerCount + 1, timeout) <= 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < workerCount; ++i) {
+        if (ready[i].fd == -1 || ready[i].revents == 0) {
+            continue;
+        }
+
+        JobResult header;
+        if (readFully(resultPipes[i][0], &header, sizeof(header)) == -1) {
+            // The worker has exited and closed its end.
+            close(resultPipes[i][0]);
+            resultPipes[i][0] = -1;
+            openResults--;
+            continue;
+        }
+
+        if (header.aIndex < 0 || header.aIndex >= aCount || header.wIndex < 0 || header.wIndex >= weightCount) {
+            fprintf(stderr, "Worker %d sent a result for an unknown job.\n", i + 1);
+            return 1;
+        }
+
+        ResultSlot *slot = &results[header.aIndex * weightCount + header.wIndex];
+        slot->rows = header.rows;
+        slot->cols = header.cols;
+        if (header.rows == RESULT_FAILED) {
+            jobsFailed++;
+        } else {
+            slot->values = allocMatrix(header.rows, header.cols);
+            if (slot->values == NULL ||
+                readFully(resultPipes[i][0], slot->values, sizeof(int) * header.rows * header.cols) == -1) {
+                fprintf(stderr, "Error while reading result from worker %d.\n", i + 1);
+                return 1;
+            }
+        }
+        jobsReceived++;
+    }
+    return 0;
+}
+
+// Stops the workers once they drain the queue and collects the remaining results. Returns 1 on failure.
+int finishSchedule() {
+    ScheduledJob stop;
+    memset(&stop, 0, sizeof(stop));
+    stop.aIndex = -1;
+
+    for (int i = 0; i < workerCount; ++i) {
+        if (sendJob(&stop) == 1) {
+            return 1;
+        }
+    }
+    close(jobPipe[1]);
+
+    while (openResults > 0) {
+        if (collectResults(-1, 0) == 1) {
+            return 1;
+        }
+    }
+
+    if (jobsReceived != jobsSent) {
+        fprintf(stderr, "%d jobs were lost with a worker that exited early.\n", jobsSent - jobsReceived);
+        return 1;
+    }
+    return 0;
+}
+
+// Writes R for every W, in A order, to PID.wN.out, where PID is the coordinator's. Returns 1 if any job failed.
+int writeResults(char *inputMatrix, char **matrixList) {
+    char outFile[FILENAME_SIZE];
+
+    for (int w = 0; w < weightCount; ++w) {
+        snprintf(outFile, FILENAME_SIZE, "%d.w%d.out", getpid(), w + 1);
+        FILE *out = fopen(outFile, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Error: Cannot open file %s\n", outFile);
+            return 1;
+        }
+
+        fprintf(out, "A = %s\n", inputMatrix);
+        fprintf(out, "W = %s\n", matrixList[w]);
+        fprintf(out, "R = [ \n");
+        int first = 1;
+        for (int a = 0; a < aCount; ++a) {
+            const ResultSlot *slot = &results[a * weightCount + w];
+            if (slot->values == NULL) {
+                fprintf(stderr, "Job %s x %s failed; see the worker's PID.err.\n", aNames[a], matrixList[w]);
+                continue;
+            }
+
+            for (int i = 0; i < slot->rows * slot->cols; ++i) {
+                if (!first && i % slot->cols == 0) fprintf(out, "\n");
+                fprintf(out, "%d ", slot->values[i]);
+                first = 0;
+            }
+        }
+        fprintf(out, "]\n");
+        fclose(out);
+    }
+
+    return jobsFailed > 0;
+}
+
+// Worker loop: takes jobs from the shared queue until told to stop, keeping every W it has loaded.
+void runWorker(const int resultFd, const char *inputMatrix, char **matrixList) {
+    CachedWeights *cache = calloc(weightCount, sizeof(CachedWeights));
+    if (cache == NULL) {
+        fprintf(stderr, "Memory allocation failed for the W cache.\n");
+        exit(1);
+    }
+
+    // Every W is padded to the columns of the command-line A, as in matrixmult_parallel
+    MatrixView firstA;
+    int firstColumns = -1;
+    if (openStoredMatrix(inputMatrix, &firstA) == -1) {
+        fprintf(stderr, "error: cannot read file %s\n", inputMatrix);
+    } else {
+        firstColumns = firstA.cols;
+        closeMatrix(&firstA);
+    }
+
+    int status = 0;
+    int jobsDone = 0;
+    ScheduledJob job;
+    while (read(jobPipe[0], &job, sizeof(job)) == sizeof(job) && job.aIndex >= 0) {
+        job.path[job.length] = '\0';
+
+        CachedWeights *weights = &cache[job.wIndex];
+        if (weights->state == 0) {
+            weights->state = firstColumns != -1 && loadWeights(weights, matrixList[job.wIndex], firstColumns) == 0 ? 1 : -1;
+        }
+
+        JobResult header = {job.aIndex, job.wIndex, RESULT_FAILED, 0};
+        int *values = NULL;
+        if (weights->state == -1 || computeJob(weights, &job, &header, &values) == 1) {
+            status = 1;
+        }
+
+        if (writeFully(resultFd, &header, sizeof(header)) == -1 ||
+            (values != NULL && writeFully(resultFd, values, sizeof(int) * header.rows * header.cols) == -1)) {
+            fprintf(stderr, "Error while writing the result of %s to the coordinator.\n", job.path);
+            exit(1);
+        }
+        free(values);
+        jobsDone++;
+    }
+
+    for (int i = 0; i < weightCount; ++i) {
+        if (cache[i].state == 1) {
+            freePackedMatrix(&cache[i].packed);
+        }
+    }
+    free(cache);
+
+    fprintf(stdout, "Computed %d jobs\n", jobsDone);
+    fflush(stdout);
+    fflush(stderr);
+    exit(status);
+}
+
+// Loads and packs W the way matrixmult_parallel does, with at least firstColumns rows. Returns 1 on failure.
+int loadWeights(CachedWeights *weights, const char *wFile, const int firstColumns) {
+    MatrixView view;
+    if (openMatrix(wFile, &view) == -1) {
+        fprintf(stderr, "error: cannot read file %s\n", wFile);
+        return 1;
+    }
+
+    weights->innerDim = maxDim(maxDim(firstColumns, view.rows), MIN_MATRIX_DIM);
+    weights->resultColumns = maxDim(view.cols, MIN_MATRIX_DIM);
+    int packed = packMatrixPadded(&weights->packed, view.data, view.rows, view.cols, weights->innerDim,
+                                  weights->resultColumns);
+    closeMatrix(&view);
+
+    if (packed == -1) {
+        fprintf(stderr, "Memory allocation failed for W matrix %s.\n", wFile);
+        return 1;
+    }
+    return 0;
+}
+
+// Multiplies the job's A by its cached W, filling in header and the result values. Returns 1 on failure.
+int computeJob(CachedWeights *weights, const ScheduledJob *job, JobResult *header, int **values) {
+    // The coordinator parsed A into the matrix store once for every W
+    MatrixView aView;
+    if (openStoredMatrix(job->path, &aView) == -1) {
+        fprintf(stderr, "error: cannot read file %s\n", job->path);
+        return 1;
+    }
+
+    if (aView.cols > weights->innerDim) {
+        fprintf(stderr, "error: matrix %s has %d columns but W has %d rows\n", job->path, aView.cols,
+                weights->innerDim);
+        closeMatrix(&aView);
+        return 1;
+    }
+    int rows = maxDim(aView.rows, MIN_MATRIX_DIM);
+
+    int *input = allocMatrix(rows, weights->innerDim);
+    int *result = allocMatrix(rows, weights->resultColumns);
+    if (input != NULL) {
+        copyMatrixPadded(aView.data, aView.rows, aView.cols, input, rows, weights->innerDim);
+    }
+    int status = input == NULL || result == NULL ||
+                 gemmPacked(input, weights->innerDim, &weights->packed, result, weights->resultColumns, rows) == -1;
+    closeMatrix(&aView);
+    free(input);
+
+    if (status) {
+        fprintf(stderr, "Multiplying %s failed.\n", job->path);
+        free(result);
+        return 1;
     }
 
+    header->rows = rows;
+    header->cols = weights->resultColumns;
+    *values = result;
     return 0;
 }
 
@@ -1,7 +1,14 @@
 /**
 * Description: This module performs matrix multiplication, utilizing forked processes for parallel computation.
 * It reads input matrices from files specified as command-line arguments, conducts parallel computations using pipes, and outputs the result to the standard output or a redirected terminal.
-* Last modified date: 12/05/2023
+* Matrix dimensions are taken from the input files and matrices live in cache-line-aligned heap buffers.
+* A matrix file names arrive through the job ring named by MATRIX_RING_FD, or through stdin when it is not set.
+* With MATRIX_STREAM set, each result is printed as soon as it is computed instead of being kept until stdin closes,
+* so memory stays constant however many A matrices arrive. The output is the same either way.
+* A matrices are mapped from the coordinator's parse-once matrix store when it holds them (see matrix_store.h).
+* Results are cached by the content hashes of A and W (see result_cache.h), so an A seen before is neither parsed nor multiplied again.
+* With MATRIX_TRACE set, the pipe wait, parse, fork, compute and assembly time of every job and the final output time are traced as JSON lines.
+* Last modified date: 10/18/2026
 * Creation date: 12/05/2023
 **/
 
@@ -13,25 +20,47 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
-#define MAX_COLUMNS 8
-#define MAX_ROWS 8
+#include "../Matrix_Common/job_ring.h"
+#include "../Matrix_Common/matrix_kernels.h"
+#include "../Matrix_Common/matrix_store.h"
+#include "../Matrix_Common/result_cache.h"
+#include "../Matrix_Common/stage_timer.h"
+
+// Upper bound on row children; each child computes a contiguous band of rows
 #define MAX_PROCESSES 8
-#define PRODUCT (MAX_ROWS * MAX_COLUMNS)
+
+// Environment variable that turns on streaming output
+#define STREAM_ENV "MATRIX_STREAM"
 
 int matrixSize;
-int input[MAX_ROWS][MAX_COLUMNS];	
+int *input;
 int *finalResultantMatrix;
-int weights[MAX_ROWS][MAX_COLUMNS]; 
-
-
-int doMatrixMult(int *aMatrix, int *tempResult);
-void rowSum(const int *matrix1, const int *matrix2, int *product, const int row);
-void fillRow(const int row, const int *sourceMatrix, int *resultant);
+PackedMatrix packedWeights; // W packed once for the multiplication kernel
+int innerDim;      // Columns of every A matrix and rows of W
+int resultColumns; // Columns of W and of every result
+int jobCount;      // A matrices multiplied so far; job 0 is the A from the command line
+double forkMicros; // Time the last doMatrixMult spent forking its children
+char weightsName[256]; // W file name, escaped for the trace
+int streamOutput;  // 1 when each result is printed as soon as it is computed
+int streamColumn;  // Column of the next streamed value
+unsigned long long streamedValues; // Values streamed so far
+int *jobInput;     // A and result buffers reused by every job from stdin
+int *jobResult;
+int jobRows;       // Rows the job buffers hold
+ResultCache resultCache;   // Results of earlier A matrices
+ContentHash weightsHash;   // Content of W and the padded inner dimension
+
+
+int doMatrixMult(int *aMatrix, const int rows, int *tempResult);
 int readAMatrix();
+int receiveAMatrixName(JobRing *ring, char *aMatrixFile);
 int closeAll(FILE *A, FILE *W, int *toFreeArray);
 void printArr(const int *resultant, const int size);
-void fillMatrix(int *resultantMatrix, const int rows, const int columns, FILE *file);
-void appendToResultant(int *tempResult);
+int appendToResultant(int *tempResult, const int count);
+int storeResult(const int *tempResult, const int count);
+int reserveJobBuffers(const int rows);
+void traceJob(const char *aFile, const int rows, double pipeWait, double parse, double compute, double assemble,
+			  const int cached);
 
 
 
@@ -59,41 +88,105 @@ int main(int argc, char *argv[]){
 		exit(closeAll(A, W, finalResultantMatrix));
 	}
 
-	fillMatrix(&(input[0][0]), MAX_ROWS, MAX_COLUMNS, A);
-	fillMatrix(&(weights[0][0]), MAX_ROWS, MAX_COLUMNS, W);
-
-	finalResultantMatrix = (int *)malloc(PRODUCT * sizeof(int));
-	if (finalResultantMatrix == NULL){
+	jsonEscape(argv[2], weightsName, sizeof(weightsName));
+	const char *stream = getenv(STREAM_ENV);
+	streamOutput = stream != NULL && *stream != '\0' && strcmp(stream, "0") != 0;
+	uint64_t mark = monotonicNanos();
+
+	// Take the dimensions from the inputs: A is rows x innerDim, W is innerDim x resultColumns.
+	// A binary W is packed straight from its file mapping, and A is mapped from the matrix store
+	// when the coordinator published it there.
+	MatrixView aView;
+	MatrixView weights;
+	if (openStoredMatrix(argv[1], &aView) == -1 || openMatrixFile(W, &weights) == -1){
+		fprintf(stderr, "error: cannot read file %s or %s\n", argv[1], argv[2]);
+		exit(closeAll(A, W, finalResultantMatrix));
+	}
+	int rowsA = maxDim(aView.rows, MIN_MATRIX_DIM);
+	innerDim = maxDim(maxDim(aView.cols, weights.rows), MIN_MATRIX_DIM);
+	resultColumns = maxDim(weights.cols, MIN_MATRIX_DIM);
+
+	input = allocMatrix(rowsA, innerDim);
+	int *tempResultant = allocMatrix(rowsA, resultColumns);
+	if (input == NULL || tempResultant == NULL ||
+		packMatrixPadded(&packedWeights, weights.data, weights.rows, weights.cols, innerDim, resultColumns) == -1){
 		fprintf(stderr,
 				"Memory allocation failed. Refer to prior messages for exact "
 				"details. A matrix %s, W matrix %s.",
 				argv[1], argv[2]);
+		free(input);
+		free(tempResultant);
+		closeMatrix(&aView);
+		closeMatrix(&weights);
 		exit(closeAll(A, W, finalResultantMatrix));
 	}
-	matrixSize += PRODUCT;
+	closeMatrix(&weights);
+
+	// W is hashed together with the inner dimension, which decides which A matrices are accepted
+	if (resultCacheInit(&resultCache) == -1 || hashMatrixFile(W, &weightsHash) == -1) resultCacheFree(&resultCache);
+	weightsHash = hashWithSetting(weightsHash, (uint64_t)innerDim);
+
+	copyMatrixPadded(aView.data, aView.rows, aView.cols, input, rowsA, innerDim);
+	closeMatrix(&aView);
+	double parse = lapMicros(&mark); // For job 0 this includes loading and packing W
 
-	int tempResultant[MAX_ROWS][MAX_COLUMNS];
-	if (doMatrixMult(&(input[0][0]), &(tempResultant[0][0])) == 1){
+	if (doMatrixMult(input, rowsA, tempResultant) == 1){
 		fprintf(stderr, "Matrix Multiplication with CLI args failed.\n");
+		free(tempResultant);
 		exit(closeAll(A, W, finalResultantMatrix));
 	}
+	double compute = lapMicros(&mark) - forkMicros;
+
+	ContentHash aHash;
+	if (resultCache.limit != 0 && hashMatrixFile(A, &aHash) == 0){
+		resultCacheStore(&resultCache, aHash, weightsHash, tempResultant, rowsA, resultColumns);
+	}
+
+	if (streamOutput){
+		fprintf(stdout, "A = %s\n", argv[1]);
+		fprintf(stdout, "W = %s\n", argv[2]);
+		fprintf(stdout, "R = [ \n");
+	}
 
-	appendToResultant(&tempResultant[0][0]);
+	if (storeResult(tempResultant, rowsA * resultColumns) == 1){
+		fprintf(stderr,
+				"Memory allocation failed. Refer to prior messages for exact "
+				"details. A matrix %s, W matrix %s.",
+				argv[1], argv[2]);
+		free(tempResultant);
+		exit(closeAll(A, W, finalResultantMatrix));
+	}
+	free(tempResultant);
+	free(input);
+	input = NULL;
+	traceJob(argv[1], rowsA, 0, parse, compute, lapMicros(&mark), 0);
 
 	if (readAMatrix() == 1){
 		fprintf(stderr, "Matrix Multiplication with passed in A matrix failed.\n");
 		exit(closeAll(A, W, finalResultantMatrix));
 	}
 
-	fprintf(stdout, "A = %s\n", argv[1]);
-	fprintf(stdout, "W = %s\n", argv[2]);
-	fprintf(stdout, "R = [ \n");
-	printArr(finalResultantMatrix, matrixSize);
+	mark = monotonicNanos();
+	if (streamOutput){
+		fprintf(stdout, "]\n");
+	}
+	else{
+		fprintf(stdout, "A = %s\n", argv[1]);
+		fprintf(stdout, "W = %s\n", argv[2]);
+		fprintf(stdout, "R = [ \n");
+		printArr(finalResultantMatrix, matrixSize);
+	}
 	free(finalResultantMatrix);
+	freePackedMatrix(&packedWeights);
+	resultCacheFree(&resultCache);
 
 	// Flush stdout and stderr 
 	fflush(stdout);
 	fflush(stderr);
+	traceRecord("\"role\": \"child\", \"event\": \"output\", \"w\": \"%s\", \"jobs\": %d, \"values\": %llu, "
+				"\"output_us\": %.3f, \"cache_hits\": %llu, \"cache_misses\": %llu",
+				weightsName, jobCount, streamOutput ? streamedValues : (unsigned long long)matrixSize, lapMicros(&mark), (unsigned long long)resultCache.hits,
+				(unsigned long long)resultCache.misses);
 
 	// Reset stdout 
 	if (dup2(atoi(argv[3]), STDOUT_FILENO) == -1){
@@ -108,59 +201,24 @@ int main(int argc, char *argv[]){
 	return 0;
 }
 
-// Fills the given matrix with the number of rows and columns with values from file
-void fillMatrix(int *resultantMatrix, const int rows, const int columns, FILE *file){
-	const int product = rows * columns;
-	int *preOp = resultantMatrix; // Store the memory address 
-	int index = 0; 
-	char line[500]; 
-	while (index < product && (!feof(file))){
-		// Only get in if the line isn't NULL.
-		if (fgets(line, sizeof(line), file) != NULL){
-
-			// Check if the last character of the string is actually a newline
-			if (line[strlen(line) - 1] == '\n'){
-				line[strlen(line) - 1] = '\0'; // Get rid of newline character.
-			}
-
-			char *fetch = strtok(line, " "); // Read in a number separated by spaces in the file.
-
-			// Keeps track of how many columns have been traversed.
-			int columnCounter = columns;
-
-			while (fetch != NULL && index < product){
-				columnCounter--;
-				int number = atoi(fetch);	
-				*(resultantMatrix) = number; 
-				resultantMatrix++;			 
-				
-				index++;				   
-				fetch = strtok(NULL, " "); 
-			}
-			resultantMatrix += columnCounter;
-		}
-	}
-
-    //return pointer to its valid memory location if the resultantMatrix pointer is incremented
-	if (resultantMatrix > preOp) resultantMatrix = preOp;
-	
-}
-
 //Multiplies the first and second matrix parallely
-int doMatrixMult(int *aMatrix, int *tempResult){
+int doMatrixMult(int *aMatrix, const int rows, int *tempResult){
+	const int processes = rows < MAX_PROCESSES ? rows : MAX_PROCESSES;
+	uint64_t mark = monotonicNanos();
+
 	// Creates read and write pipes for each child process.
 	int fd[MAX_PROCESSES][2];
 
 	// Create pipes to read and write for all processes.
-	for (int i = 0; i < MAX_PROCESSES; i++){
+	for (int i = 0; i < processes; i++){
 		if (pipe(fd[i]) == -1){
 			fprintf(stderr, "Error creating pipes.\n");
 			exit(1);
 		}
 	}
 
-	// Calculate dot product of each row of the matrix 
-	for (int i = 0; i < MAX_PROCESSES; ++i){
+	// Calculate dot products of one band of rows per process
+	for (int i = 0; i < processes; ++i){
 
 		// Store the PID of each process. 
 		pid_t pid = fork(); // Hold PIDs for child process.
@@ -171,168 +229,268 @@ int doMatrixMult(int *aMatrix, int *tempResult){
 		}
 		else if (pid == 0){
 			// Close unnecessary read and write ends of the pipe.
-			for (int j = 0; j < MAX_PROCESSES; ++j){
+			for (int j = 0; j < processes; ++j){
 				close(fd[j][0]); 
 				if (j != i) close(fd[j][1]); // Close all write ends except for the current.
 				
 			}
 
-            // ends the process if passing the row number to parent process fails
-			if (write(fd[i][1], &i, sizeof(int)) == -1){
-				fprintf(stderr,
-						"Error while writing row number. Problematic child: %d. "
-						"Iteration: %d.\n",
-						getpid(), i);
+			const int firstRow = (int)((long)rows * i / processes);
+			const int lastRow = (int)((long)rows * (i + 1) / processes);
+
+			// Calculate the whole band of rows with the shared kernel.
+			int *bandResult = allocMatrix(lastRow - firstRow, resultColumns);
+			if (bandResult == NULL ||
+				gemmPacked(aMatrix + (size_t)firstRow * innerDim, innerDim, &packedWeights,
+						   bandResult, resultColumns, lastRow - firstRow) == -1){
+				fprintf(stderr, "Memory allocation failed in child %d.\n", getpid());
 				exit(1);
 			}
 
-			// Calculate and store the dot product of specific row.
-			int rowResult[MAX_COLUMNS];
-			rowSum(aMatrix, &(weights[0][0]), rowResult, i);
+			for (int row = firstRow; row < lastRow; ++row){
+				// ends the process if passing the row number to parent process fails
+				if (writeFully(fd[i][1], &row, sizeof(int)) == -1){
+					fprintf(stderr,
+							"Error while writing row number. Problematic child: %d. "
+							"Iteration: %d.\n",
+							getpid(), row);
+					exit(1);
+				}
 
-			if (write(fd[i][1], rowResult, sizeof(int) * MAX_COLUMNS) == -1){
-				fprintf(stderr,
-						"Error while writing array. Problematic child: %d. Iteration: "
-						"%d.\n",
-						getpid(), i);
-				exit(1);
+				const int *rowResult = bandResult + (size_t)(row - firstRow) * resultColumns;
+				if (writeFully(fd[i][1], rowResult, sizeof(int) * resultColumns) == -1){
+					fprintf(stderr,
+							"Error while writing array. Problematic child: %d. Iteration: "
+							"%d.\n",
+							getpid(), row);
+					exit(1);
+				}
 			}
 
+			free(bandResult);
 			close(fd[i][1]); // Close write pipe once written.
 			exit(0);		 // End the child process so it doesn't fork itself.
 		}
 	}
 
-	// Parent process.
-	for (int i = 0; i < MAX_PROCESSES; ++i){
-		int wstatus;
-		int childPID = wait(&wstatus); // Wait for each child process to end.
+	forkMicros = lapMicros(&mark);
 
-		if (WIFEXITED(wstatus)){
-			// Check if the child process exited normally.
-			int exitStatus =
-				WEXITSTATUS(wstatus); // Store exit code of child process.
-			if (exitStatus == 0){
-				// If the child process exited with code 0 (success)
-				// Holds the row values returned by the child process.
-				int rowResult[MAX_COLUMNS];
-
-				int rowCompleted; // The row that the child process calculated.
-
-				// Reads in the row that the child process calculated.
-				if (read(fd[i][0], &rowCompleted, sizeof(int)) == -1){
-					fprintf(stderr, "Error while reading value. Problematic child: %d\n",
-							childPID);
-					exit(1);
-				}
+	// Parent process. Drain every pipe before waiting so children never block on a full pipe.
+	int failed = 0;
+	for (int i = 0; i < processes; ++i){
+		close(fd[i][1]);
 
-				// Reads in the row values that the child process calculated.
-				if (read(fd[i][0], rowResult, sizeof(int) * MAX_COLUMNS) == -1){
-					fprintf(stderr, "Error while reading value. Problematic child: %d\n",
-							childPID);
-					exit(1);
-				}
+		const int bandRows = (int)((long)rows * (i + 1) / processes) - (int)((long)rows * i / processes);
+		for (int r = 0; r < bandRows && !failed; ++r){
+			int rowCompleted; // The row that the child process calculated.
 
-				close(fd[i][0]); // Close the read pipe after use.
-				fillRow(rowCompleted, rowResult, tempResult);
+			// Reads in the row that the child process calculated.
+			if (readFully(fd[i][0], &rowCompleted, sizeof(int)) == -1 || rowCompleted < 0 || rowCompleted >= rows){
+				fprintf(stderr, "Error while reading value from child %d.\n", i);
+				failed = 1;
+				break;
 			}
-			else{
-				// In case the child process failed.
-				fprintf(stderr, "Child %d exited abnormally with code %d.\n", childPID,
-						exitStatus);
-				exit(1);
+
+			// Reads the row values straight into their place in the result.
+			if (readFully(fd[i][0], tempResult + (size_t)rowCompleted * resultColumns, sizeof(int) * resultColumns) == -1){
+				fprintf(stderr, "Error while reading value from child %d.\n", i);
+				failed = 1;
 			}
 		}
+
+		close(fd[i][0]); // Close the read pipe after use.
+	}
+
+	for (int i = 0; i < processes; ++i){
+		int wstatus;
+		int childPID = wait(&wstatus); // Wait for each child process to end.
+
+		if (WIFEXITED(wstatus) && WEXITSTATUS(wstatus) != 0){
+			// In case the child process failed.
+			fprintf(stderr, "Child %d exited abnormally with code %d.\n", childPID,
+					WEXITSTATUS(wstatus));
+			failed = 1;
+		}
+		else if (WIFSIGNALED(wstatus)){
+			fprintf(stderr, "Child %d killed with signal %d.\n", childPID, WTERMSIG(wstatus));
+			failed = 1;
+		}
 	}
+
+	if (failed) exit(1);
 	return 0;
 }
 
 int readAMatrix(){
+	uint64_t mark = monotonicNanos();
+	JobRing *ring = attachJobRing();
+	char aMatrixFile[PATH_MAX];
+
 	while (1){
-		size_t bufferLen;
+		int received = receiveAMatrixName(ring, aMatrixFile);
 
-		if (read(STDIN_FILENO, &bufferLen, sizeof(size_t)) == 0) break;
+		if (received == 0) break;
 
-		if (bufferLen == 0) break;
-		
-		char aMatrixFile[bufferLen + 1];
-
-		if (read(STDIN_FILENO, aMatrixFile, bufferLen) == -1){
-			fprintf(stderr, "Error copying A matrix filename from pipe.\n");
+		if (received == -1){
+			unmapJobRing(ring);
 			return 1;
 		}
-
-		aMatrixFile[bufferLen] = '\0';
+		double pipeWait = lapMicros(&mark);
 
 		FILE *aMatrix = fopen(aMatrixFile, "r");
 		if (aMatrix == NULL){
 			fprintf(stderr, "error: cannot open file %s read in from stdin\n",
 					aMatrixFile);
 			fprintf(stderr, "Terminating, exit code 1.\n");
+			unmapJobRing(ring);
 			return 1;
 		}
 
-		int tempA[MAX_ROWS][MAX_COLUMNS];
-		memset(tempA, 0, sizeof(tempA));
+		// An A seen before is served from the cache without being parsed or multiplied again
+		ContentHash aHash;
+		const int cacheable = resultCache.limit != 0 && hashMatrixFile(aMatrix, &aHash) == 0;
+		const CacheEntry *cached = cacheable ? resultCacheLookup(&resultCache, aHash, weightsHash) : NULL;
+		if (cached != NULL && cached->cols == resultColumns){
+			fclose(aMatrix);
+			double lookup = lapMicros(&mark);
+			if (storeResult(cached->values, cached->rows * cached->cols) == 1){
+				fprintf(stderr, "realloc() failed for matrix %s.", aMatrixFile);
+				unmapJobRing(ring);
+				return 1;
+			}
+			forkMicros = 0;
+			traceJob(aMatrixFile, cached->rows, pipeWait, lookup, 0, lapMicros(&mark), 1);
+			continue;
+		}
+
+		fclose(aMatrix);
+
+		// Map the copy the coordinator parsed into the matrix store, or parse the file when there is none
+		MatrixView aView;
+		if (openStoredMatrix(aMatrixFile, &aView) == -1){
+			fprintf(stderr, "error: cannot read file %s read in from stdin\n", aMatrixFile);
+			unmapJobRing(ring);
+			return 1;
+		}
+
+		if (aView.cols > innerDim){
+			fprintf(stderr, "error: matrix %s has %d columns but W has %d rows\n",
+					aMatrixFile, aView.cols, innerDim);
+			closeMatrix(&aView);
+			unmapJobRing(ring);
+			return 1;
+		}
+		int rows = maxDim(aView.rows, MIN_MATRIX_DIM);
 
-		fillMatrix(&(tempA[0][0]), MAX_ROWS, MAX_COLUMNS, aMatrix);
+		if (reserveJobBuffers(rows) == 1){
+			fprintf(stderr, "Memory allocation failed for matrix %s.\n", aMatrixFile);
+			closeMatrix(&aView);
+			unmapJobRing(ring);
+			return 1;
+		}
 
-		int tempAResult[0][0];
-		memset(tempAResult, 0, sizeof(tempAResult));
+		// copyMatrixPadded zeroes whatever A leaves out, so nothing from the previous job remains
+		copyMatrixPadded(aView.data, aView.rows, aView.cols, jobInput, rows, innerDim);
+		closeMatrix(&aView);
+		double parse = lapMicros(&mark);
 
-		if (doMatrixMult(&(tempA[0][0]), &(tempAResult[0][0]))){
+		if (doMatrixMult(jobInput, rows, jobResult)){
 			fprintf(stderr, "Matrix Multiplication with stdin args failed.\n");
+			unmapJobRing(ring);
 			return 1;
 		}
+		double compute = lapMicros(&mark) - forkMicros;
+
+		if (cacheable) resultCacheStore(&resultCache, aHash, weightsHash, jobResult, rows, resultColumns);
 
-		matrixSize += PRODUCT;
-		int *tempResultArray = (int *)realloc(finalResultantMatrix, matrixSize * sizeof(int));
-		if (tempResultArray == NULL){
+		if (storeResult(jobResult, rows * resultColumns) == 1){
 			fprintf(stderr, "realloc() failed for matrix %s.", aMatrixFile);
-			matrixSize -= PRODUCT;
+			unmapJobRing(ring);
 			return 1;
 		}
-		finalResultantMatrix = tempResultArray;
-
-		appendToResultant(&(tempAResult[0][0]));
+		traceJob(aMatrixFile, rows, pipeWait, parse, compute, lapMicros(&mark), 0);
 	}
 
+	free(jobInput);
+	free(jobResult);
+	jobInput = jobResult = NULL;
+	jobRows = 0;
+	unmapJobRing(ring);
 	return 0;
 }
 
-// Appends the value of the first array to the end of the second
-void appendToResultant(int *tempResult){
-	
-    int *resultStart = finalResultantMatrix + (matrixSize - PRODUCT);
-	for (int i = 0; i < PRODUCT; ++i){
-		*(resultStart + i) = *(tempResult + i);
+// Takes the next A matrix file name from the job ring, or from stdin when there is no ring.
+// Returns 1 with the name in aMatrixFile, 0 at the end of input and -1 on failure.
+int receiveAMatrixName(JobRing *ring, char *aMatrixFile){
+	if (ring != NULL){
+		int length = popJob(ring, aMatrixFile);
+		if (length == -1){
+			fprintf(stderr, "Coordinator exited before ending the job ring.\n");
+			return -1;
+		}
+		return length > 0;
 	}
-}
 
-// Calculates the dot product of the specified row in matrix1 with the entirety of matrix2, and stores the result in the product result.
-void rowSum(const int *matrix1, const int *matrix2, int *product, const int row) {
-    const int rowStart = row * MAX_COLUMNS;
+	size_t bufferLen;
+
+	if (read(STDIN_FILENO, &bufferLen, sizeof(size_t)) <= 0) return 0;
 
-    for (int i = 0; i < MAX_COLUMNS; ++i) {
-        int result = 0;
+	if (bufferLen == 0) return 0;
 
-        for (int j = 0; j < MAX_COLUMNS; ++j) {
-            const int rowIncrement = rowStart + j;
-            const int columnIncrement = j * MAX_COLUMNS + i;
-            result += matrix1[rowIncrement] * matrix2[columnIncrement];
-        }
+	if (bufferLen >= PATH_MAX || readFully(STDIN_FILENO, aMatrixFile, bufferLen) == -1){
+		fprintf(stderr, "Error copying A matrix filename from pipe.\n");
+		return -1;
+	}
 
-        *(product + i) = result;
-    }
+	aMatrixFile[bufferLen] = '\0';
+	return 1;
 }
 
+// Grows the final resultant matrix by count values and copies tempResult onto its end
+int appendToResultant(int *tempResult, const int count){
+	int *tempResultArray = (int *)realloc(finalResultantMatrix, (size_t)(matrixSize + count) * sizeof(int));
+	if (tempResultArray == NULL) return 1;
 
-// Fills the specified row in the resultant matrix with the values from the source matrix.
-void fillRow(const int row, const int *sourceMatrix, int *resultant){
-	const int rowStart = row * MAX_ROWS;
-	for (int i = 0; i < MAX_COLUMNS; ++i){
-		*(resultant + (rowStart + i)) = *(sourceMatrix + i);
+	finalResultantMatrix = tempResultArray;
+	memcpy(finalResultantMatrix + matrixSize, tempResult, (size_t)count * sizeof(int));
+	matrixSize += count;
+	return 0;
+}
+
+// Prints a result straight away when streaming, and otherwise appends it to the final resultant matrix
+int storeResult(const int *tempResult, const int count){
+	if (!streamOutput) return appendToResultant((int *)tempResult, count);
+
+	// Rows are separated exactly as printArr separates them, so both modes print the same text.
+	// Only the column is tracked, so a stream of any length never overflows a count.
+	for (int i = 0; i < count; ++i){
+		if (streamColumn == 0 && (streamedValues != 0 || i != 0)) fprintf(stdout, "\n");
+
+		fprintf(stdout, "%d ", tempResult[i]);
+		streamColumn = (streamColumn + 1) % resultColumns;
 	}
+	streamedValues += count;
+	return fflush(stdout) == EOF;
+}
+
+// Makes the job buffers hold at least rows rows, keeping them when they already do
+int reserveJobBuffers(const int rows){
+	if (rows <= jobRows) return 0;
+
+	free(jobInput);
+	free(jobResult);
+	jobInput = allocMatrix(rows, innerDim);
+	jobResult = allocMatrix(rows, resultColumns);
+	if (jobInput == NULL || jobResult == NULL){
+		free(jobInput);
+		free(jobResult);
+		jobInput = jobResult = NULL;
+		jobRows = 0;
+		return 1;
+	}
+
+	jobRows = rows;
+	return 0;
 }
 
 //Flushes stdout and stderr, and then closes the passed in files.
@@ -362,9 +520,23 @@ int closeAll(FILE *A, FILE *W, int *toFreeArray){
 //Prints the contens of the array.
 void printArr(const int *resultant, const int size){
 	for (int i = 0; i < size; ++i){
-		if ((i != 0) && (i % MAX_COLUMNS == 0)) fprintf(stdout, "\n");
+		if ((i != 0) && (i % resultColumns == 0)) fprintf(stdout, "\n");
 		
 		fprintf(stdout, "%d ", *(resultant + i));
 	}
 	fprintf(stdout, "]\n");
 }
+
+// Appends the stage times of one job to the trace and counts the job
+void traceJob(const char *aFile, const int rows, double pipeWait, double parse, double compute, double assemble,
+			  const int cached){
+	if (traceEnabled()){
+		char name[256];
+		traceRecord("\"role\": \"child\", \"event\": \"job\", \"w\": \"%s\", \"job\": %d, \"a\": \"%s\", \"rows\": %d, "
+					"\"cached\": %d, \"pipe_wait_us\": %.3f, \"parse_us\": %.3f, \"fork_us\": %.3f, "
+					"\"compute_us\": %.3f, \"assemble_us\": %.3f",
+					weightsName, jobCount, jsonEscape(aFile, name, sizeof(name)), rows, cached, pipeWait, parse,
+					forkMicros, compute, assemble);
+	}
+	jobCount++;
+}
@@ -1,7 +1,9 @@
 /**
 * Description: This module performs parallel matrix multiplication of two input matrices (A and W)
 * and prints the result matrix along with the runtime in seconds
-* Last modified date: 09/24/2023
+* A fixed pool of worker processes is forked once at startup; every row of A is queued as a job
+* on a shared pipe so all rows are in flight at the same time.
+* Last modified date: 10/18/2026
 * Creation date: 09/19/ 2023
 **/
 
@@ -12,63 +14,44 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <poll.h>
 #include <time.h>
 
+#include "../Matrix_Common/matrix_kernels.h"
+
 /**
- * Reads a matrix from a file and stores it in an array.
- *
- * Assumptions:
- * - The file format contains space-separated values.
- * - Each row of the matrix is on a separate line.
- * - The matrix dimensions are defined by rows and cols.
- * - If a row has fewer values than cols, missing values are treated as 0.
+ * Body of a pooled worker process.
+ * Pulls row indices from the shared job pipe until it is closed, multiplies each row and
+ * sends the row index followed by the row values back on the worker's own result pipe.
  *
- * file: The file pointer for reading.
- * matrix: The target array for storing the matrix.
- * rows: The number of rows in the matrix.
- * cols: The number of columns in the matrix.
+ * jobFd: read end of the shared job pipe.
+ * resultFd: write end of this worker's result pipe.
  */
-
-
-// Function to read a matrix from a file into a 1D array
-void readMatrixFromFile(FILE *file, int *matrix, int rows, int cols) {
-
-    // Assuming a line will have less than 1024 characters
-    char buffer[1024];
-
-    for (int i = 0; i < rows; i++) {
-        if (fgets(buffer, sizeof(buffer), file) != NULL) {
-            char *token = strtok(buffer, " ");
-            for (int j = 0; j < cols; j++) {
-                if (token != NULL) {
-                    // Convert token to integer and store in matrix
-                    // If no more tokens, set matrix element to 0
-                    matrix[i * cols + j] = atoi(token);
-                    token = strtok(NULL, " ");
-                } else {
-                    matrix[i * cols + j] = 0;
-                }
-            }
+void runWorker(int jobFd, int resultFd, int *A, const PackedMatrix *W, int *R, int colsA, int colsW) {
+    int row;
+
+    // Each job is a single int written atomically, so concurrent readers never split one
+    while (read(jobFd, &row, sizeof(int)) == sizeof(int)) {
+        if (gemmPacked(A + row * colsA, colsA, W, R + row * colsW, colsW, 1) == -1 ||
+            writeFully(resultFd, &row, sizeof(int)) == -1 ||
+            writeFully(resultFd, R + row * colsW, colsW * sizeof(int)) == -1) {
+            fprintf(stderr, "Worker %d failed to send row %d.\n", getpid(), row);
+            exit(1);
         }
     }
-}
 
-// Multiplies a single row of matrix A by matrix W and stores the result in matrix R.
-void multiplyRow(int *A, int *W, int *R, int rowA, int colsA, int colsW) {
-    for (int j = 0; j < colsW; j++) {
-        R[rowA * colsW + j] = 0;
-        for (int k = 0; k < colsA; k++) {
-            R[rowA * colsW + j] += A[rowA * colsA + k] * W[k * colsW + j];
-        }
-    }
+    close(jobFd);
+    close(resultFd);
+    exit(0);
 }
 
 int main(int argc, char *argv[]) {
     clock_t start_time, end_time;
     double execution_time;
 
-    if (argc != 3) {
-        fprintf(stderr, "error: expecting exactly 2 files as input\nTerminating, exit code 1.\n");
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "error: expecting 2 files as input and an optional worker count\n"
+                        "Usage: %s <A_matrix_file> <W_matrix_file> [workers]\nTerminating, exit code 1.\n", argv[0]);
         exit(1);
     }
 
@@ -104,56 +87,147 @@ int main(int argc, char *argv[]) {
     int A[rowsA * colsA];
     int W[colsA * colsW];
 
-    readMatrixFromFile(fileA, A, rowsA, colsA);
-    readMatrixFromFile(fileW, W, colsA, colsW);
+    int statusA = readMatrixFromFile(fileA, A, rowsA, colsA);
+    int statusW = readMatrixFromFile(fileW, W, colsA, colsW);
 
     fclose(fileA);
     fclose(fileW);
 
+    if (statusA == -1 || statusW == -1) {
+        fprintf(stderr, "Error reading file %s.\n", statusA == -1 ? argv[1] : argv[2]);
+        printf("Terminating, exit code 1.\n");
+        exit(1);
+    }
+
+    // Pack W once before forking; every worker inherits the packed copy
+    PackedMatrix packedW;
+    if (packMatrix(&packedW, W, colsA, colsW) == -1) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(1);
+    }
+
     // Result matrix
     int R[rowsA * colsW];
 
-    // Create processes (one for each row of A)
-    for (int i = 0; i < rowsA; i++) {
-        pid_t pid;
-        int pipefd[2];
+    // Size the worker pool: optional third argument, otherwise one worker per online CPU
+    int numWorkers = (argc == 4) ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (numWorkers < 1) {
+        numWorkers = 1;
+    }
+    if (numWorkers > rowsA) {
+        numWorkers = rowsA;
+    }
+
+    // Shared job pipe: the parent queues row indices, idle workers pull the next one
+    int jobPipe[2];
+    if (pipe(jobPipe) == -1) {
+        perror("Pipe creation failed");
+        exit(1);
+    }
 
-        if (pipe(pipefd) == -1) {
+    // One result pipe per worker so rows of any width arrive unbroken
+    int resultPipes[numWorkers][2];
+
+    // Fork the worker pool once
+    for (int w = 0; w < numWorkers; w++) {
+        if (pipe(resultPipes[w]) == -1) {
             perror("Pipe creation failed");
             exit(1);
         }
 
-        pid = fork();
+        pid_t pid = fork();
         // Child process
         if (pid == 0) {
-            close(pipefd[0]);
-
-            multiplyRow(A, W, R, i, colsA, colsW);
-
-            // Send the result row through the pipe to the parent
-            write(pipefd[1], R + i * colsW, colsW * sizeof(int));
+            close(jobPipe[1]);
+            for (int k = 0; k <= w; k++) {
+                close(resultPipes[k][0]);
+                if (k != w) {
+                    close(resultPipes[k][1]);
+                }
+            }
 
-            close(pipefd[1]);
-            exit(0);
+            runWorker(jobPipe[0], resultPipes[w][1], A, &packedW, R, colsA, colsW);
         } else if (pid < 0) {
             fprintf(stderr, "Fork error.\n");
             exit(1);
         }
 
-        // Parent process
-        // Close write end of the pipe
-        close(pipefd[1]);
+        // Parent process close write end of the result pipe
+        close(resultPipes[w][1]);
+    }
+    close(jobPipe[0]);
 
-        // Read the result row from the child through the pipe
-        read(pipefd[0], R + i * colsW, colsW * sizeof(int));
+    // Queue every row and collect results as they complete, so all rows are in flight at once
+    struct pollfd fds[numWorkers + 1];
+    int nextRow = 0;
+    int rowsDone = 0;
+    int openWorkers = numWorkers;
 
-        close(pipefd[0]);
+    for (int w = 0; w < numWorkers; w++) {
+        fds[w].fd = resultPipes[w][0];
+        fds[w].events = POLLIN;
     }
+    fds[numWorkers].fd = jobPipe[1];
+    fds[numWorkers].events = POLLOUT;
 
-    // Wait for all child processes to finish and report their status
-    while (wait(NULL) > -1) {
-        int status;
+    while (rowsDone < rowsA && openWorkers > 0) {
+        if (poll(fds, numWorkers + 1, -1) == -1) {
+            perror("Poll error");
+            exit(1);
+        }
+
+        // Hand out more rows while the job pipe has room
+        if (fds[numWorkers].fd != -1 && (fds[numWorkers].revents & POLLOUT)) {
+            if (writeFully(jobPipe[1], &nextRow, sizeof(int)) == -1) {
+                perror("Write error");
+                exit(1);
+            }
+            if (++nextRow == rowsA) {
+                // No more jobs: closing the pipe lets idle workers exit
+                close(jobPipe[1]);
+                fds[numWorkers].fd = -1;
+            }
+        }
+
+        for (int w = 0; w < numWorkers; w++) {
+            if (fds[w].fd == -1 || !(fds[w].revents & (POLLIN | POLLHUP))) {
+                continue;
+            }
+
+            int row;
+            if (readFully(fds[w].fd, &row, sizeof(int)) == -1) {
+                // Worker finished and closed its pipe
+                close(fds[w].fd);
+                fds[w].fd = -1;
+                openWorkers--;
+                continue;
+            }
 
+            if (row < 0 || row >= rowsA || readFully(fds[w].fd, R + row * colsW, colsW * sizeof(int)) == -1) {
+                perror("Read error");
+                exit(1);
+            }
+            rowsDone++;
+        }
+    }
+
+    if (rowsDone < rowsA) {
+        fprintf(stderr, "Workers exited before all rows were computed.\n");
+        exit(1);
+    }
+
+    if (fds[numWorkers].fd != -1) {
+        close(jobPipe[1]);
+    }
+    for (int w = 0; w < numWorkers; w++) {
+        if (fds[w].fd != -1) {
+            close(fds[w].fd);
+        }
+    }
+
+    // Wait for all child processes to finish and report their status
+    int status;
+    while (wait(&status) > 0) {
         if (WIFEXITED(status)) {
             printf("Child terminated normally with exit code: %d\n", WEXITSTATUS(status));
         } else if (WIFSIGNALED(status)) {
@@ -178,5 +252,7 @@ int main(int argc, char *argv[]) {
 
     // Print runtime in seconds
     printf("Runtime %.4f seconds\n", execution_time);
+
+    freePackedMatrix(&packedW);
     return 0;
 }
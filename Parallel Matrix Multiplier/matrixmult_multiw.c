@@ -1,8 +1,9 @@
 /**
 * Description: This module performs performs parallel matrix multiplication by forking child processes to calculating the product of a matrix A with multiple matrices W using
 * executable matrixmult_parallel file, and reporting results and execution times.
+* A is parsed once into a shared-memory matrix store, and each matrixmult_parallel maps that copy instead of parsing A again.
 
-* Last modified date: 10/11/2023
+* Last modified date: 10/18/2026
 * Creation date: 10/02/2023
 **/
 
@@ -14,32 +15,8 @@
 #include <string.h>
 #include <fcntl.h>
 
-/**
- * This function reads a matrix from a file into D array.
- * Assumption: The matrix in the file is represented row-wise.
- * Input parameters: file, matrix, rows, cols
- **/
-void readMatrixFromFile(FILE *file, int *matrix, int rows, int cols) {
-
-    // Assume the line will have less than 1024 characters
-    char buffer[1024];
-
-    for (int i = 0; i < rows; i++) {
-        if (fgets(buffer, sizeof(buffer), file) != NULL) {
-            char *token = strtok(buffer, " ");
-            for (int j = 0; j < cols; j++) {
-                if (token != NULL) {
-
-                    // Convert token to an integer and store it in the matrix
-                    matrix[i * cols + j] = atoi(token);
-                    token = strtok(NULL, " ");
-                } else {
-                    matrix[i * cols + j] = 0;
-                }
-            }
-        }
-    }
-}
+#include "../Matrix_Common/matrix_io.h"
+#include "../Matrix_Common/matrix_store.h"
 
 /**
  * This function prints a matrix.
@@ -122,6 +99,11 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
 
+    // Parse A once; each matrixmult_parallel inherits MATRIX_STORE_DIR and maps the stored copy.
+    // The forked children below only read the first 8x8 values, which is cheaper than mapping.
+    createMatrixStore();
+    publishMatrix(argv[1]);
+
     // Loop through additional W matrix files
     for (int i = 2; i < argc; i++) {
         pid_t child_pid = fork();
@@ -138,13 +120,19 @@ int main(int argc, char *argv[]) {
             // Read and process matrix A
             int matrixA[8][8] = {0};
             FILE *fileA = fopen(argv[1], "r");
-            readMatrixFromFile(fileA, (int *)matrixA, 8, 8);
+            if (fileA == NULL || readMatrixFromFile(fileA, (int *)matrixA, 8, 8) == -1) {
+                fprintf(stderr, "Error reading input file %s.\n", argv[1]);
+                exit(1);
+            }
             fclose(fileA);
 
             // Read and process matrix Wi
             int matrixWi[8][8] = {0};
             FILE *fileWi = fopen(argv[i], "r");
-            readMatrixFromFile(fileWi, (int *)matrixWi, 8, 8);
+            if (fileWi == NULL || readMatrixFromFile(fileWi, (int *)matrixWi, 8, 8) == -1) {
+                fprintf(stderr, "Error reading input file %s.\n", argv[i]);
+                exit(1);
+            }
             fclose(fileWi);
 
             // Simulate matrix multiplication
@@ -185,5 +173,6 @@ int main(int argc, char *argv[]) {
     // Execute matrix multiplication with the specified input files in parallel
     executeMatrixMultMultiw(A_file, W_files, argc - 2);
 
+    removeMatrixStore();
     return 0;
 }
@@ -1,7 +1,11 @@
 /**
 * Description: This module performs performs parallel matrix multiplication by forking child processes.
+* A and R live in one shared anonymous mapping; each child writes its rows of R in place and
+* only its exit status goes back to the parent. W is packed once before forking, straight from the
+* file mapping when it is a binary matrix file. Matrix dimensions are taken from the input files.
+* A is mapped from the matrix store of matrixmult_multiw when it was published there, instead of being parsed.
 
-* Last modified date: 10/17/2023
+* Last modified date: 10/18/2026
 * Creation date: 10/02/2023
 **/
 
@@ -9,60 +13,19 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <time.h>
 
-// Define ROWS and COLS here
-#define ROWS 8
-#define COLS 8
+#include "../Matrix_Common/matrix_kernels.h"
+#include "../Matrix_Common/matrix_store.h"
 
-
-/**
- * This function reads a matrix from a file into a D array.
- * Assumption: The matrix in the file is represented row-wise.
- * Input parameters: file, matrix, rows, cols
- **/
-void readMatrixFromFile(FILE *file, int *matrix, int rows, int cols) {
-    // Initialize the matrix with zeros
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            matrix[i * cols + j] = 0;
-        }
-    }
-
-    // Read the values from the file and fill in the matrix
-    char buffer[1024];
-
-    for (int i = 0; i < rows; i++) {
-        if (fgets(buffer, sizeof(buffer), file) != NULL) {
-            char *token = strtok(buffer, " ");
-            for (int j = 0; j < cols; j++) {
-                if (token != NULL) {
-                    
-                    // Convert token to integer and store in matrix
-                    matrix[i * cols + j] = atoi(token);
-                    token = strtok(NULL, " ");
-                } else {
-                    break;
-                }
-            }
-        }
-    }
-}
+// Upper bound on row children; each child computes a contiguous band of rows
+#define MAX_PROCESSES 8
 
 
-// Multiplies a single row of matrix A by matrix W and stores the result in matrix R.
-void multiplyRow(int *A, int *W, int *R, int rowA, int colsA, int colsW) {
-    for (int j = 0; j < colsW; j++) {
-        R[rowA * colsW + j] = 0;
-        for (int k = 0; k < colsA; k++) {
-            R[rowA * colsW + j] += A[rowA * colsA + k] * W[k * colsW + j];
-        }
-    }
-}
-
 int main(int argc, char *argv[]) {
     clock_t start_time, end_time;
     double execution_time;
@@ -97,67 +60,92 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
 
-    // Read matrices from files using readMatrixFromFile
-    int A[ROWS * COLS];
-    int W[COLS * COLS];
+    // Take the dimensions from the inputs: A is rowsA x inner, W is inner x colsW.
+    // A binary W is used in place from its file mapping, and so is a stored copy of A.
+    MatrixView viewA;
+    MatrixView viewW;
+    if (openStoredMatrix(argv[1], &viewA) == -1 || openMatrixFile(fileW, &viewW) == -1) {
+        fprintf(stderr, "Error reading input file(s).\n");
+        exit(1);
+    }
+    int rowsA = maxDim(viewA.rows, MIN_MATRIX_DIM);
+    int inner = maxDim(maxDim(viewA.cols, viewW.rows), MIN_MATRIX_DIM);
+    int colsW = maxDim(viewW.cols, MIN_MATRIX_DIM);
+
+    // A and R share one anonymous mapping that every child inherits across fork().
+    // Each matrix starts on its own cache line.
+    size_t sizeA = cacheLineRound((size_t)rowsA * inner * sizeof(int));
+    size_t sizeR = cacheLineRound((size_t)rowsA * colsW * sizeof(int));
+    size_t sharedSize = sizeA + sizeR;
+    char *shared = mmap(NULL, sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap failed");
+        exit(1);
+    }
+
+    int *A = (int *)shared;
+    int *R = (int *)(shared + sizeA);
 
-    readMatrixFromFile(fileA, A, ROWS, COLS);
-    readMatrixFromFile(fileW, W, COLS, COLS);
+    // Copy A into the shared mapping, zero-padded to rowsA x inner
+    copyMatrixPadded(viewA.data, viewA.rows, viewA.cols, A, rowsA, inner);
+    closeMatrix(&viewA);
 
     fclose(fileA);
     fclose(fileW);
 
-    // Result matrix
-    int R[ROWS * COLS];
-
-    // Create processes (one for each row of A)
-    for (int i = 0; i < ROWS; i++) {
-        pid_t pid;
-        int pipefd[2];
-
-        if (pipe(pipefd) == -1) {
-            perror("Pipe creation failed");
-            exit(1);
-        }
+    // Pack W once before forking; every child inherits the packed copy
+    PackedMatrix packedW;
+    if (packMatrixPadded(&packedW, viewW.data, viewW.rows, viewW.cols, inner, colsW) == -1) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(1);
+    }
+    closeMatrix(&viewW);
 
-        pid = fork();
+    // Create processes (one per band of rows of A), all running at the same time
+    int numProcesses = rowsA < MAX_PROCESSES ? rowsA : MAX_PROCESSES;
+    for (int p = 0; p < numProcesses; p++) {
+        pid_t pid = fork();
         // Child process
         if (pid == 0) {
-            close(pipefd[0]);
-
-            multiplyRow(A, W, R, i, COLS, COLS);
-
-            // Send the result row through the pipe to the parent
-            write(pipefd[1], R + i * COLS, COLS * sizeof(int));
-
-            close(pipefd[1]);
+            int firstRow = (int)((long)rowsA * p / numProcesses);
+            int lastRow = (int)((long)rowsA * (p + 1) / numProcesses);
+
+            // Write the result rows straight into the shared R
+            if (gemmPacked(A + (size_t)firstRow * inner, inner, &packedW,
+                           R + (size_t)firstRow * colsW, colsW, lastRow - firstRow) == -1) {
+                fprintf(stderr, "Memory allocation failed in child %d.\n", getpid());
+                exit(1);
+            }
             exit(0);
         } else if (pid < 0) {
             fprintf(stderr, "Fork error.\n");
             exit(1);
         }
-        // Parent process close write end of the pipe
-        close(pipefd[1]);
-
-        // Read the result row from the child through the pipe
-        ssize_t bytes_read = read(pipefd[0], R + i * COLS, COLS * sizeof(int));
-        if (bytes_read == -1) {
-            perror("Read error");
-            exit(1);
-        }
-        close(pipefd[0]);
     }
 
-    // Wait for all child processes to finish and report their status
+    // Wait for all child processes to finish and report their status.
+    // A normal exit is the completion signal: the rows are already in R.
     int status;
+    bool childFailed = false;
     while (waitpid(-1, &status, 0) > 0) {
         if (WIFEXITED(status)) {
             printf("Child terminated normally with exit code: %d\n", WEXITSTATUS(status));
+            if (WEXITSTATUS(status) != 0) {
+                childFailed = true;
+            }
         } else if (WIFSIGNALED(status)) {
             printf("Child terminated abnormally with signal number: %d\n", WTERMSIG(status));
+            childFailed = true;
         }
     }
 
+    if (childFailed) {
+        fprintf(stderr, "A child failed, result matrix is incomplete.\n");
+        freePackedMatrix(&packedW);
+        munmap(shared, sharedSize);
+        exit(1);
+    }
+
 
     // Stop measuring execution time
     end_time = clock();
@@ -165,9 +153,9 @@ int main(int argc, char *argv[]) {
 
     // Print the result matrix and include input file names
     printf("Result of %s * %s = [\n", argv[1], argv[2]);
-    for (int i = 0; i < ROWS; i++) {
-        for (int j = 0; j < COLS; j++) {
-            printf("%d ", R[i * COLS + j]);
+    for (int i = 0; i < rowsA; i++) {
+        for (int j = 0; j < colsW; j++) {
+            printf("%d ", R[(size_t)i * colsW + j]);
         }
         printf("\n");
     }
@@ -176,5 +164,8 @@ int main(int argc, char *argv[]) {
 
     // Print runtime in seconds
     printf("Runtime %.4f seconds\n", execution_time);
+
+    freePackedMatrix(&packedW);
+    munmap(shared, sharedSize);
     return 0;
 }
@@ -1,7 +1,7 @@
 /**
 * Description: This module performs implements matrix multiplication in parallel by forking child processes for each matrix, communicating through pipes, and redirecting output to separate files for each process, ensuring effective inter-process communication and synchronization.
- 
-* Last modified date: 12/05/2023
+* Status lines go to PID.out and PID.err through an asynchronous logger that syncs them in batches; MATRIX_LOG_DURABILITY picks none, batch or sync.
+* Last modified date: 10/18/2026
 * Creation date: 12/05/2023
 **/
 
@@ -15,6 +15,8 @@
 #include <signal.h>
 #include <errno.h>
 
+#include "../Matrix_Common/async_log.h"
+
 #define MAX_ROWS 8
 #define MAX_COLUMNS 8
 #define FILENAME_SIZE 15
@@ -22,6 +24,7 @@
 
 int pipes[MAX_COLUMNS][2];
 int realStdout;
+AsyncLog statusLog; // Carries the status lines the coordinator appends to PID.out and PID.err
 
 clock_t startClock, endClock, inputStart, inputEnd;
 double cpuTimeUsed, inputTime;
@@ -32,6 +35,7 @@ void releaseMemory(char **dynamicMatrix, const int items);
 
 int main(int argc, char *argv[]) {
     startClock = clock();
+    logInit(&statusLog);
     if (argc < 3) {
         fprintf(stderr, "You must pass in at least 2 matrices as input.\n");
         return 1;
@@ -90,8 +94,8 @@ int calculateMultiplication(char *inputMatrix, char **matrixList, const int matr
             snprintf(outFile, FILENAME_SIZE, "%d.out", childPID);
             snprintf(errFile, FILENAME_SIZE, "%d.err", childPID);
             // Create the actual files on disk, open in write only and append mode
-            outFD = open(outFile, O_WRONLY | O_CREAT | O_APPEND | O_DSYNC, 0644);
-            errFD = open(errFile, O_WRONLY | O_CREAT | O_APPEND | O_DSYNC, 0644);
+            outFD = open(outFile, O_WRONLY | O_CREAT | O_APPEND | logOpenFlags(&statusLog), 0644);
+            errFD = open(errFile, O_WRONLY | O_CREAT | O_APPEND | logOpenFlags(&statusLog), 0644);
             // Redirect stderr and stdout to errFile and outFile
             if ((dup2(errFD, STDERR_FILENO) == -1) || (dup2(outFD, STDOUT_FILENO) == -1)) {
                 fprintf(stderr, "Redirecting stderr and stdout failed.\n");
@@ -133,36 +137,32 @@ int calculateMultiplication(char *inputMatrix, char **matrixList, const int matr
         // Create a string that results in PID.out and PID.err
         snprintf(outFile, FILENAME_SIZE, "%d.out", childPID);
         snprintf(errFile, FILENAME_SIZE, "%d.err", childPID);
-        outFD = open(outFile, O_WRONLY | O_APPEND | O_DSYNC, 0644);
-        errFD = open(errFile, O_WRONLY | O_APPEND | O_DSYNC, 0644);
-        // Redirect stdout and stderr to out_file and err_file.
-        dup2(outFD, STDOUT_FILENO);
-        dup2(errFD, STDERR_FILENO);
-        fprintf(stdout, "Finished child %d pid of parent %d\n", childPID, getpid());
-        fflush(stdout);
+        // The lines go through the log, which writes and syncs them in batches and closes the files after
+        outFD = open(outFile, O_WRONLY | O_APPEND | O_CLOEXEC | logOpenFlags(&statusLog), 0644);
+        errFD = open(errFile, O_WRONLY | O_APPEND | O_CLOEXEC | logOpenFlags(&statusLog), 0644);
+        if (outFD != -1) {
+            logPrintf(&statusLog, outFD, "Finished child %d pid of parent %d\n", childPID, getpid());
+        }
         if (WIFEXITED(wstatus)) {
             int exitStatus = WEXITSTATUS(wstatus); // Store exit code of child process.
-            if (exitStatus == 0) {
-                fprintf(stdout, "Exited with exitcode = %d\n", exitStatus);
-                fflush(stdout);
-            } else {
-                fprintf(stderr, "Exited with exitcode = %d\n", exitStatus);
+            if (exitStatus == 0 && outFD != -1) {
+                logPrintf(&statusLog, outFD, "Exited with exitcode = %d\n", exitStatus);
+            } else if (exitStatus != 0 && errFD != -1) {
+                logPrintf(&statusLog, errFD, "Exited with exitcode = %d\n", exitStatus);
             }
-        } else if (WIFSIGNALED(wstatus)) {
-            fprintf(stderr, "Killed with signal %d\n", WTERMSIG(wstatus));
+        } else if (WIFSIGNALED(wstatus) && errFD != -1) {
+            logPrintf(&statusLog, errFD, "Killed with signal %d\n", WTERMSIG(wstatus));
         }
-        fflush(stdout);
-        fflush(stderr);
+        logCloseFile(&statusLog, outFD);
+        logCloseFile(&statusLog, errFD);
         // Close read end of pipe.
         close(pipes[i][0]);
     }
-    if (dup2(realStdout, STDOUT_FILENO) == -1) {
-        fprintf(stderr, "Redirecting stdout to terminal failed.\n");
+    // Every status line is on disk, as far as the durability asks, before the run is reported done
+    if (logShutdown(&statusLog) == -1) {
+        fprintf(stderr, "Writing the status logs failed: %s\n", strerror(errno));
         return 1;
     }
-    // Close all file descriptors
-    close(outFD);
-    close(errFD);
     return 0;
 }
 
@@ -1,11 +1,19 @@
 /**
 * Description: This module performs matrix multiplication using multithreading. It reads matrices from files specified as command-line arguments, Calculates them in parallel using threads, and prints the resulting matrix.
- 
-* Last modified date: 12/05/2023
+
+* Rows are computed by a team of worker threads that is created once and reused for every A matrix read from stdin.
+* Each team member takes rows from its own queue and steals rows from the other queues once its own is empty.
+* Each row is multiplied with the shared fixed-shape kernel picked for this CPU at startup.
+* Threads write each result row into its own cache line and take no lock. The main thread collects the rows
+* once the completion barrier hands them over.
+* Last modified date: 10/18/2026
 * Creation date: 12/05/2023
 **/
 
 #include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,28 +21,59 @@
 #include <unistd.h>
 #include <pthread.h>
 
+#include "../Matrix_Common/matrix_fixed.h"
+
 #define MAX_COLUMNS 8
 #define MAX_ROWS 8
 #define MAX_THREADS 8
 #define PRODUCT (MAX_ROWS * MAX_COLUMNS)
 
+// Times a waiting thread polls before it sleeps on a condition variable
+#define SPIN_LIMIT 2000
+
+// Rows handed out by one team member; the other members steal from it once their own queue is empty
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_int next; // Next row to hand out
+    int end;                                   // One past the last row of this queue
+} RowQueue;
+
+// One result row alone on its cache line, so threads writing neighbouring rows never share a line
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) int values[MAX_COLUMNS];
+} PaddedRow;
+
+// Worker threads created once and reused for every matrix. The main thread is member 0.
+typedef struct {
+    pthread_t threads[MAX_THREADS];
+    RowQueue queues[MAX_THREADS];
+    int members;            // Worker threads plus the main thread
+    int *aMatrix;           // A matrix of the current job
+    PaddedRow *tempResult;  // Result rows of the current job
+    atomic_uint generation; // Bumped to start a job
+    atomic_int remaining;   // Workers that have not finished the current job; releases their rows to the main thread
+    atomic_int stop;        // Set to make the workers exit
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t finished;
+} ThreadTeam;
+
 int matrixSize;
 int input[MAX_ROWS][MAX_COLUMNS];
 int *finalResultantMatrix;
 int weights[MAX_ROWS][MAX_COLUMNS];
-int tempResultant[MAX_ROWS][MAX_COLUMNS];
-
-pthread_mutex_t mutex; // Mutex lock for synchronization
+PaddedRow tempResultant[MAX_ROWS];
+ThreadTeam team;
 
-int doMatrixMult(int *aMatrix, int *tempResult);
-void rowSum(const int *matrix1, const int *matrix2, int *product, const int row);
-void fillRow(const int row, const int *sourceMatrix, int *resultant);
+int doMatrixMult(int *aMatrix, PaddedRow *tempResult);
+void rowProduct(const int *aMatrix, const int *wMatrix, PaddedRow *product, const int row);
 int readAMatrix();
 int closeAll(FILE *A, FILE *W, int *toFreeArray);
 void printArr(const int *resultant, const int size);
-void fillMatrix(int *resultantMatrix, const int rows, const int columns, FILE *file);
-void appendToResultant(int *tempResult);
+void appendToResultant(const PaddedRow *tempResult);
+int growResultant();
 void *matrixMultThread(void *args);
+int startTeam();
+void stopTeam();
 
 int main(int argc, char *argv[]) {
     if (argc != 4) {
@@ -59,43 +98,50 @@ int main(int argc, char *argv[]) {
         exit(closeAll(A, W, finalResultantMatrix));
     }
 
-    fillMatrix(&(input[0][0]), MAX_ROWS, MAX_COLUMNS, A);
-    fillMatrix(&(weights[0][0]), MAX_ROWS, MAX_COLUMNS, W);
+    // Text or binary matrix files are both accepted
+    int statusA = readMatrixFromFile(A, &(input[0][0]), MAX_ROWS, MAX_COLUMNS);
+    int statusW = readMatrixFromFile(W, &(weights[0][0]), MAX_ROWS, MAX_COLUMNS);
+    if (statusA == -1 || statusW == -1) {
+        fprintf(stderr, "Error: Cannot read file %s\n", statusA == -1 ? argv[1] : argv[2]);
+        fprintf(stderr, "Terminating, exit code 1.\n");
+        exit(closeAll(A, W, finalResultantMatrix));
+    }
 
-    finalResultantMatrix = (int *)malloc(PRODUCT * sizeof(int));
-    if (finalResultantMatrix == NULL) {
+    // Create the worker team once; it serves the command-line A and every A read from stdin
+    if (startTeam() == 1) {
+        fprintf(stderr, "Thread team initialization failed.\n");
+        exit(closeAll(A, W, finalResultantMatrix));
+    }
+
+    if (growResultant() == 1) {
         fprintf(stderr,
                 "Memory allocation failed. Refer to prior messages for exact "
                 "details. A matrix %s, W matrix %s.",
                 argv[1], argv[2]);
+        stopTeam();
         exit(closeAll(A, W, finalResultantMatrix));
     }
-    matrixSize += PRODUCT;
 
-    // Initialize mutex
-    if (pthread_mutex_init(&mutex, NULL) != 0) {
-        fprintf(stderr, "Mutex initialization failed.\n");
-        exit(closeAll(A, W, finalResultantMatrix));
-    }
-
-    int tempResultant[MAX_ROWS][MAX_COLUMNS];
-    if (doMatrixMult(&(input[0][0]), &(tempResultant[0][0])) == 1) {
+    if (doMatrixMult(&(input[0][0]), tempResultant) == 1) {
         fprintf(stderr, "Matrix Multiplication with CLI args failed.\n");
+        stopTeam();
         exit(closeAll(A, W, finalResultantMatrix));
     }
 
-    appendToResultant(&tempResultant[0][0]);
-
     if (readAMatrix() == 1) {
         fprintf(stderr, "Matrix Multiplication with passed in A matrix failed.\n");
+        stopTeam();
         exit(closeAll(A, W, finalResultantMatrix));
     }
 
+    stopTeam();
+
     fprintf(stdout, "A = %s\n", argv[1]);
     fprintf(stdout, "W = %s\n", argv[2]);
     fprintf(stdout, "R = [ \n");
     printArr(finalResultantMatrix, matrixSize);
     free(finalResultantMatrix);
+    finalResultantMatrix = NULL;
 
     // Flush stdout and stderr
     fflush(stdout);
@@ -111,97 +157,146 @@ int main(int argc, char *argv[]) {
     fclose(A);
     fclose(W);
 
-    // Destroy the mutex
-    pthread_mutex_destroy(&mutex);
-
     return 0;
 }
 
+// Creates one worker per online CPU beyond the main thread, up to MAX_THREADS members in all
+int startTeam() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int wanted = cpus < 1 ? 1 : (cpus > MAX_THREADS ? MAX_THREADS : (int)cpus);
 
-// Fills the given matrix with the number of rows and columns with values from file
-void fillMatrix(int *resultantMatrix, const int rows, const int columns, FILE *file) {
-    const int product = rows * columns;
-    int *preOp = resultantMatrix; // Store the memory address
-    int index = 0;
-    char line[500];
-    while (index < product && (!feof(file))) {
-        // Only get in if the line isn't NULL.
-        if (fgets(line, sizeof(line), file) != NULL) {
-            // Check if the last character of the string is actually a newline
-            if (line[strlen(line) - 1] == '\n') {
-                line[strlen(line) - 1] = '\0'; // Get rid of newline character.
-            }
+    if (pthread_mutex_init(&team.lock, NULL) != 0 || pthread_cond_init(&team.start, NULL) != 0 ||
+        pthread_cond_init(&team.finished, NULL) != 0) {
+        return 1;
+    }
+    atomic_init(&team.generation, 0);
+    atomic_init(&team.remaining, 0);
+    atomic_init(&team.stop, 0);
+
+    team.members = 1;
+    for (int i = 1; i < wanted; ++i) {
+        if (pthread_create(&team.threads[i], NULL, matrixMultThread, (void *)(intptr_t)i) != 0) {
+            fprintf(stderr, "Error creating thread %d, continuing with %d.\n", i + 1, team.members);
+            break;
+        }
+        team.members++;
+    }
+    return 0;
+}
 
-            char *fetch = strtok(line, " "); // Read in a number separated by spaces in the file.
+// Wakes the workers with the stop flag set and waits for them to exit
+void stopTeam() {
+    pthread_mutex_lock(&team.lock);
+    atomic_store(&team.stop, 1);
+    pthread_cond_broadcast(&team.start);
+    pthread_mutex_unlock(&team.lock);
 
-            // Keeps track of how many columns have been traversed.
-            int columnCounter = columns;
+    for (int i = 1; i < team.members; ++i) {
+        pthread_join(team.threads[i], NULL);
+    }
+    team.members = 1;
 
-            while (fetch != NULL && index < product) {
-                columnCounter--;
-                int number = atoi(fetch);
-                *(resultantMatrix) = number;
-                resultantMatrix++;
-                index++;
-                fetch = strtok(NULL, " ");
+    pthread_mutex_destroy(&team.lock);
+    pthread_cond_destroy(&team.start);
+    pthread_cond_destroy(&team.finished);
+}
+
+// Returns the next row for a member: from its own queue first, then stolen from the others. -1 when none are left.
+int takeRow(const int member) {
+    for (int i = 0; i < team.members; ++i) {
+        RowQueue *queue = &team.queues[(member + i) % team.members];
+        if (atomic_load_explicit(&queue->next, memory_order_relaxed) < queue->end) {
+            int row = atomic_fetch_add_explicit(&queue->next, 1, memory_order_relaxed);
+            if (row < queue->end) {
+                return row;
             }
-            resultantMatrix += columnCounter;
         }
     }
-
-    // return pointer to its valid memory location if the resultantMatrix pointer is incremented
-    if (resultantMatrix > preOp)
-        resultantMatrix = preOp;
+    return -1;
 }
 
-// Multiplies the first and second matrix parallely using threads
-int doMatrixMult(int *aMatrix, int *tempResult) {
-    pthread_t threads[MAX_THREADS];
+// Computes rows of the current job until every queue is empty. Each row has its own slot, so no lock is needed.
+void runRows(const int member) {
+    int row;
+    while ((row = takeRow(member)) != -1) {
+        rowProduct(team.aMatrix, &(weights[0][0]), team.tempResult, row);
+    }
+}
 
-    // Create threads to calculate dot product of each row of the matrix
-    for (int i = 0; i < MAX_THREADS; ++i) {
-        int *threadArgs = (int *)malloc(sizeof(int));
-        if (threadArgs == NULL) {
-            fprintf(stderr, "Memory allocation failed for thread arguments.\n");
-            return 1;
-        }
-        *threadArgs = i;
+// Multiplies the first and second matrix parallely using the thread team and appends the result
+int doMatrixMult(int *aMatrix, PaddedRow *tempResult) {
+    team.aMatrix = aMatrix;
+    team.tempResult = tempResult;
 
-        if (pthread_create(&threads[i], NULL, matrixMultThread, (void *)threadArgs) != 0) {
-            fprintf(stderr, "Error creating thread %d.\n", i + 1);
-            free(threadArgs);
-            return 1;
-        }
+    // Give each member a contiguous block of rows
+    for (int i = 0; i < team.members; ++i) {
+        team.queues[i].end = MAX_ROWS * (i + 1) / team.members;
+        atomic_store_explicit(&team.queues[i].next, MAX_ROWS * i / team.members, memory_order_relaxed);
     }
+    atomic_store_explicit(&team.remaining, team.members - 1, memory_order_relaxed);
+
+    // Publish the job; the release pairs with the acquire in matrixMultThread
+    pthread_mutex_lock(&team.lock);
+    atomic_fetch_add_explicit(&team.generation, 1, memory_order_release);
+    pthread_cond_broadcast(&team.start);
+    pthread_mutex_unlock(&team.lock);
+
+    runRows(0);
 
-    // Wait for all threads to finish
-    for (int i = 0; i < MAX_THREADS; ++i) {
-        pthread_join(threads[i], NULL);
+    // Completion barrier: every worker checks out once it finds no rows left
+    for (int spin = 0; spin < SPIN_LIMIT && atomic_load_explicit(&team.remaining, memory_order_acquire) > 0; ++spin) {
+    }
+    if (atomic_load_explicit(&team.remaining, memory_order_acquire) > 0) {
+        pthread_mutex_lock(&team.lock);
+        while (atomic_load_explicit(&team.remaining, memory_order_acquire) > 0) {
+            pthread_cond_wait(&team.finished, &team.lock);
+        }
+        pthread_mutex_unlock(&team.lock);
     }
 
+    // The acquire loads above saw every worker's release, so all rows are visible here
+    appendToResultant(tempResult);
     return 0;
 }
 
-// Thread function to calculate dot product of a row
+// Worker loop: waits for a job, computes rows with the rest of the team, then checks out at the barrier
 void *matrixMultThread(void *args) {
-    int threadIndex = *((int *)args);
-    free(args);
-
-    for (int i = threadIndex; i < MAX_ROWS; i += MAX_THREADS) {
-        rowSum(&(input[i][0]), &(weights[i][0]), tempResultant[i], i);
-        pthread_mutex_lock(&mutex);
-        appendToResultant(tempResultant[i]);
-        pthread_mutex_unlock(&mutex);
+    const int member = (int)(intptr_t)args;
+    unsigned seen = 0;
+
+    while (1) {
+        // Spin briefly for the next job, then sleep until it is published
+        int spin = 0;
+        while (atomic_load_explicit(&team.generation, memory_order_acquire) == seen &&
+               !atomic_load_explicit(&team.stop, memory_order_relaxed) && spin < SPIN_LIMIT) {
+            ++spin;
+        }
+        pthread_mutex_lock(&team.lock);
+        while (atomic_load_explicit(&team.generation, memory_order_acquire) == seen && !atomic_load(&team.stop)) {
+            pthread_cond_wait(&team.start, &team.lock);
+        }
+        pthread_mutex_unlock(&team.lock);
+
+        if (atomic_load(&team.stop)) {
+            break;
+        }
+        seen = atomic_load_explicit(&team.generation, memory_order_acquire);
+
+        runRows(member);
+
+        if (atomic_fetch_sub_explicit(&team.remaining, 1, memory_order_acq_rel) == 1) {
+            pthread_mutex_lock(&team.lock);
+            pthread_cond_signal(&team.finished);
+            pthread_mutex_unlock(&team.lock);
+        }
     }
 
-    pthread_exit(NULL);
+    return NULL;
 }
-// Sums the ith row of the first matrix with the second matrix
-void rowSum(const int *matrix1, const int *matrix2, int *product, const int row) {
-    for (int i = 0; i < MAX_COLUMNS; i++) {
-        *(product + row * MAX_COLUMNS + i) = *(matrix1 + row * MAX_COLUMNS + i) +
-                                             *(matrix2 + row * MAX_COLUMNS + i);
-    }
+
+// Multiplies the ith row of the first matrix by the second matrix
+void rowProduct(const int *aMatrix, const int *wMatrix, PaddedRow *product, const int row) {
+    gemmShape(aMatrix + row * MAX_COLUMNS, wMatrix, product[row].values, 1, MAX_COLUMNS, MAX_COLUMNS);
 }
 
 // Prints the array
@@ -214,46 +309,66 @@ void printArr(const int *resultant, const int size) {
     fprintf(stdout, "];\n");
 }
 
-// Fills in the resultant array at the end of the parallel matrix multiplication
-void appendToResultant(int *tempResult) {
+// Copies the finished rows of a job into the newest matrix of the resultant array. Only the main thread calls it.
+void appendToResultant(const PaddedRow *tempResult) {
+    int *destination = finalResultantMatrix + (matrixSize - PRODUCT);
     for (int i = 0; i < MAX_ROWS; i++) {
-        for (int j = 0; j < MAX_COLUMNS; j++) {
-            *(finalResultantMatrix + i * MAX_COLUMNS + j) = *(tempResult + i * MAX_COLUMNS + j);
-        }
+        memcpy(destination + i * MAX_COLUMNS, tempResult[i].values, sizeof(tempResult[i].values));
     }
 }
 
-// Reads from A matrix passed in through the terminal
-int readAMatrix() {
-    char line[500];
-    int *resultant = (int *)malloc(PRODUCT * sizeof(int));
-    if (resultant == NULL) {
-        fprintf(stderr, "Memory allocation failed for A matrix.");
+// Adds room for one more matrix at the end of the resultant array
+int growResultant() {
+    int *grown = (int *)realloc(finalResultantMatrix, (size_t)(matrixSize + PRODUCT) * sizeof(int));
+    if (grown == NULL) {
         return 1;
     }
-    int index = 0;
-    while (!feof(stdin)) {
-        if (fgets(line, sizeof(line), stdin) != NULL) {
-            // Check if the last character of the string is actually a newline
-            if (line[strlen(line) - 1] == '\n') {
-                line[strlen(line) - 1] = '\0'; // Get rid of newline character.
-            }
+    finalResultantMatrix = grown;
+    matrixSize += PRODUCT;
+    return 0;
+}
 
-            char *fetch = strtok(line, " "); // Read in a number separated by spaces in the file.
+// Reads the A matrix file names the coordinator sends through stdin, each as its length followed by the name,
+// and multiplies each A with the team. A length of 0 or the end of the pipe ends the stream.
+int readAMatrix() {
+    char aMatrixFile[PATH_MAX];
 
-            while (fetch != NULL && index < matrixSize) {
-                int number = atoi(fetch);
-                *(resultant + index) = number;
-                index++;
-                fetch = strtok(NULL, " ");
-            }
+    while (1) {
+        size_t bufferLen;
+
+        if (readFully(STDIN_FILENO, &bufferLen, sizeof(size_t)) == -1 || bufferLen == 0)
+            break;
+
+        // A length too long for a path means the stream is corrupt
+        if (bufferLen >= PATH_MAX || readFully(STDIN_FILENO, aMatrixFile, bufferLen) == -1) {
+            fprintf(stderr, "Error copying A matrix filename from pipe.\n");
+            return 1;
         }
-    }
+        aMatrixFile[bufferLen] = '\0';
 
-    // Close the file to prevent memory leaks.
-    free(finalResultantMatrix);
-    finalResultantMatrix = resultant;
-    matrixSize += PRODUCT;
+        FILE *aMatrix = fopen(aMatrixFile, "r");
+        if (aMatrix == NULL) {
+            fprintf(stderr, "Error: Cannot open file %s read in from stdin\n", aMatrixFile);
+            return 1;
+        }
+        int status = readMatrixFromFile(aMatrix, &(input[0][0]), MAX_ROWS, MAX_COLUMNS);
+        fclose(aMatrix);
+        if (status == -1) {
+            // A malformed A is reported and skipped; the next one from stdin is still multiplied
+            fprintf(stderr, "Error: Cannot read matrix file %s read in from stdin\n", aMatrixFile);
+            continue;
+        }
+
+        if (growResultant() == 1) {
+            fprintf(stderr, "Memory allocation failed for A matrix %s.\n", aMatrixFile);
+            return 1;
+        }
+
+        if (doMatrixMult(&(input[0][0]), tempResultant) == 1) {
+            fprintf(stderr, "Matrix Multiplication with stdin args failed.\n");
+            return 1;
+        }
+    }
 
     return 0;
 }